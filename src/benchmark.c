@@ -0,0 +1,353 @@
+#include "benchmark.h"
+#include "compositor.h"
+#include "display.h"
+#include "entity.h"
+#include "palette.h"
+#include "timing.h"
+
+/**
+ * Times a handful of frames on every render driver SDL has and returns the
+ * index of the fastest one, or -1 if none of them worked.
+ *
+ * Each frame does what the game does every frame: upload a full window of
+ * pixels to a streaming texture, copy it to the screen and present. The first
+ * few frames are thrown away because drivers tend to do lazy setup work in
+ * them.
+ */
+int benchmark_render_drivers(uint32_t renderer_flags) {
+	int warmup_frames = 5;
+	int measured_frames = 30;
+
+	uint32_t* pixels = malloc(sizeof(uint32_t) * (window_width * window_height));
+	if (!pixels) {
+		return -1;
+	}
+
+	int fastest_driver = -1;
+	double fastest_frame_ms = 0;
+
+	for (int driver = 0; driver < SDL_GetNumRenderDrivers(); driver++) {
+		SDL_RendererInfo info;
+		if (SDL_GetRenderDriverInfo(driver, &info) != 0) {
+			continue;
+		}
+
+		SDL_Renderer* candidate = SDL_CreateRenderer(window, driver, renderer_flags);
+		if (!candidate) {
+			fprintf(stderr, "  %s: unavailable\n", info.name);
+			continue;
+		}
+		SDL_Texture* texture = SDL_CreateTexture(
+			candidate,
+			SDL_PIXELFORMAT_ARGB8888,
+			SDL_TEXTUREACCESS_STREAMING,
+			window_width,
+			window_height
+		);
+		if (!texture) {
+			fprintf(stderr, "  %s: unavailable\n", info.name);
+			SDL_DestroyRenderer(candidate);
+			continue;
+		}
+
+		uint64_t start = 0;
+		for (int frame = 0; frame < warmup_frames + measured_frames; frame++) {
+			if (frame == warmup_frames) {
+				start = timing_now();
+			}
+			// Change the pixels every frame so no driver can skip the upload.
+			uint32_t color = 0xFF000000 | (frame * 0x00010101);
+			for (int i = 0; i < window_width * window_height; i++) {
+				pixels[i] = color;
+			}
+			SDL_UpdateTexture(texture, NULL, pixels, (int)(window_width * sizeof(uint32_t)));
+			SDL_RenderClear(candidate);
+			SDL_RenderCopy(candidate, texture, NULL, NULL);
+			SDL_RenderPresent(candidate);
+		}
+		double frame_ms = timing_ms_between(start, timing_now()) / measured_frames;
+		fprintf(stderr, "  %s: %.2fms per frame\n", info.name, frame_ms);
+
+		if (fastest_driver == -1 || frame_ms < fastest_frame_ms) {
+			fastest_driver = driver;
+			fastest_frame_ms = frame_ms;
+		}
+
+		SDL_DestroyTexture(texture);
+		SDL_DestroyRenderer(candidate);
+	}
+
+	free(pixels);
+	return fastest_driver;
+}
+
+// Player-sized triangle with its top-left corner at (x, y), the same shape
+// draw_player() makes.
+void player_triangle(float x, float y, vec2_t* a, vec2_t* b, vec2_t* c) {
+	a->x = x + 4;
+	a->y = y + 15;
+	b->x = x + 10;
+	b->y = y + 4;
+	c->x = x + 15;
+	c->y = y + 15;
+}
+
+/**
+ * Draws the same player triangles with the old three-line outline and with the
+ * filled rasterizer and prints the cost of each. This runs without a window,
+ * it only needs a color buffer to draw into.
+ */
+void benchmark_raster(void) {
+	int triangles = 200000;
+
+	uint32_t* previous_color_buffer = color_buffer;
+	color_buffer = calloc(window_width * window_height, sizeof(uint32_t));
+	if (!color_buffer) {
+		color_buffer = previous_color_buffer;
+		return;
+	}
+
+	vec2_t a, b, c;
+	// Move the triangles around, including sub-pixel offsets, so we aren't
+	// timing one lucky position over and over.
+	uint64_t start = timing_now();
+	for (int i = 0; i < triangles; i++) {
+		player_triangle((i * 7) % 380 + (i % 16) / 16.0f, (i * 13) % 380, &a, &b, &c);
+		draw_line(a, b, 0xFFCCCCCC);
+		draw_line(b, c, 0xFFCCCCCC);
+		draw_line(c, a, 0xFFCCCCCC);
+	}
+	double line_ms = timing_ms_between(start, timing_now());
+
+	start = timing_now();
+	for (int i = 0; i < triangles; i++) {
+		player_triangle((i * 7) % 380 + (i % 16) / 16.0f, (i * 13) % 380, &a, &b, &c);
+		draw_filled_triangle(a, b, c, 0xFFCCCCCC);
+	}
+	double filled_ms = timing_ms_between(start, timing_now());
+
+	fprintf(stderr, "Player triangle, %d draws:\n", triangles);
+	fprintf(stderr, "  outline with draw_line: %.1fns each\n", line_ms * 1e6 / triangles);
+	fprintf(stderr, "  filled rasterizer:      %.1fns each\n", filled_ms * 1e6 / triangles);
+
+	free(color_buffer);
+	color_buffer = previous_color_buffer;
+}
+
+/**
+ * Blends a 1920x1080 layer over an opaque frame, once with the per-pixel
+ * scalar kernel and once with blend_pixels(). The layer is a mix of
+ * transparent, opaque and translucent pixels, like a busy game layer, and is
+ * drawn at partial opacity so neither kernel can take the opaque shortcut.
+ */
+void benchmark_blend(void) {
+	int width = 1920;
+	int height = 1080;
+	int pixel_count = width * height;
+	int frames = 100;
+
+	uint32_t* frame = malloc(sizeof(uint32_t) * pixel_count);
+	uint32_t* layer = malloc(sizeof(uint32_t) * pixel_count);
+	if (!frame || !layer) {
+		free(frame);
+		free(layer);
+		return;
+	}
+	for (int i = 0; i < pixel_count; i++) {
+		uint32_t alpha = (i / 64) % 3 == 0 ? 0 : (i / 64) % 3 == 1 ? 0xFF : 0x80;
+		layer[i] = (alpha << 24) | ((i * 2654435761u) & 0x00FFFFFF);
+	}
+
+	double kernel_ms[2];
+	for (int kernel = 0; kernel < 2; kernel++) {
+		for (int i = 0; i < pixel_count; i++) {
+			frame[i] = 0xFF202020;
+		}
+		uint64_t start = timing_now();
+		for (int f = 0; f < frames; f++) {
+			if (kernel == 0) {
+				blend_pixels_scalar(frame, layer, pixel_count, 200);
+			} else {
+				blend_pixels(frame, layer, pixel_count, 200);
+			}
+		}
+		kernel_ms[kernel] = timing_ms_between(start, timing_now()) / frames;
+	}
+
+	fprintf(stderr, "Blending one %dx%d layer:\n", width, height);
+	fprintf(stderr, "  scalar: %.3fms\n", kernel_ms[0]);
+	fprintf(stderr, "  vector: %.3fms\n", kernel_ms[1]);
+
+	free(frame);
+	free(layer);
+}
+
+// Uniform random float in [0, 1), deterministic so runs can be compared.
+float benchmark_random(uint32_t* state) {
+	*state = *state * 1664525u + 1013904223u;
+	return (*state >> 8) / 16777216.0f;
+}
+
+/**
+ * Runs 100k colliding entities for ten seconds of 60Hz ticks, doing
+ * everything a game tick does with entities: move them, rebuild the spatial
+ * hash, bounce overlapping entities off each other, look for the ones
+ * touching a player and draw them into a screen-sized buffer. They live in
+ * an open world a little over 300 cells across, about one entity per cell,
+ * so most of them are outside the level and get culled.
+ */
+void benchmark_entities(void) {
+	int entity_count = 100000;
+	int ticks = 600;
+	float tick_seconds = 1.0f / 60.0f;
+	float world_size = 316;
+
+	entities_t entities;
+	spatial_hash_t hash;
+	if (!create_entities(&entities, entity_count)) {
+		return;
+	}
+	if (!create_spatial_hash(&hash, entity_count)) {
+		destroy_entities(&entities);
+		return;
+	}
+	// The window isn't open yet, so draw into a buffer of our own.
+	uint32_t* screen = malloc(sizeof(uint32_t) * window_width * window_height);
+	if (!screen) {
+		destroy_spatial_hash(&hash);
+		destroy_entities(&entities);
+		return;
+	}
+	uint32_t* previous_color_buffer = color_buffer;
+	color_buffer = screen;
+
+	uint32_t seed = 1;
+	for (int i = 0; i < entity_count; i++) {
+		vec2_t position = {
+			.x = benchmark_random(&seed) * world_size,
+			.y = benchmark_random(&seed) * world_size,
+		};
+		vec2_t velocity = {
+			.x = (benchmark_random(&seed) - 0.5f) * 4,
+			.y = (benchmark_random(&seed) - 0.5f) * 4,
+		};
+		spawn_entity(&entities, ENTITY_HAZARD, position, velocity, ENTITY_FLAG_COLLIDES);
+	}
+
+	double update_ms = 0;
+	double build_ms = 0;
+	double collide_ms = 0;
+	double query_ms = 0;
+	double draw_ms = 0;
+	long bounces = 0;
+	long touches = 0;
+	int touching[64];
+
+	for (int tick = 0; tick < ticks; tick++) {
+		uint64_t start = timing_now();
+		update_entities(&entities, NULL, tick_seconds);
+		uint64_t updated = timing_now();
+		build_spatial_hash(&hash, &entities);
+		uint64_t built = timing_now();
+		bounces += collide_entities(&hash, &entities);
+		uint64_t collided = timing_now();
+		// A handful of player-sized queries spread over the world.
+		for (int q = 0; q < 16; q++) {
+			box_t player = {
+				.min = { .x = q * 19.0f, .y = q * 17.0f },
+				.max = { .x = q * 19.0f + 0.5f, .y = q * 17.0f + 0.5f },
+			};
+			touches += query_spatial_hash(&hash, player, touching, 64);
+		}
+		uint64_t queried = timing_now();
+		draw_entities(&entities);
+		uint64_t drawn = timing_now();
+
+		update_ms += timing_ms_between(start, updated);
+		build_ms += timing_ms_between(updated, built);
+		collide_ms += timing_ms_between(built, collided);
+		query_ms += timing_ms_between(collided, queried);
+		draw_ms += timing_ms_between(queried, drawn);
+	}
+
+	double tick_ms = (update_ms + build_ms + collide_ms + query_ms + draw_ms) / ticks;
+	fprintf(stderr, "%d entities, %d ticks:\n", entity_count, ticks);
+	fprintf(stderr, "  update:         %.3fms per tick (no walls, so no wall sweeps)\n", update_ms / ticks);
+	fprintf(stderr, "  build hash:     %.3fms per tick\n", build_ms / ticks);
+	fprintf(stderr, "  entity/entity:  %.3fms per tick (%ld bounces)\n", collide_ms / ticks, bounces);
+	fprintf(stderr, "  player queries: %.3fms per tick (%ld hits)\n", query_ms / ticks, touches);
+	fprintf(stderr, "  draw:           %.3fms per tick\n", draw_ms / ticks);
+	fprintf(stderr, "  total:          %.3fms per tick, %.0f%% of a 60Hz tick\n", tick_ms, tick_ms / (tick_seconds * 1000) * 100);
+
+	color_buffer = previous_color_buffer;
+	free(screen);
+	destroy_spatial_hash(&hash);
+	destroy_entities(&entities);
+}
+
+/**
+ * Compares the work palette mode saves and the work it adds on a 1920x1080
+ * frame. Clearing stands in for every fill: it's the same bytes written, a
+ * quarter as many in 8-bit. Expanding the indices to colors is the added
+ * cost, timed with the scalar and the vector kernels.
+ */
+void benchmark_palette(void) {
+	int width = 1920;
+	int height = 1080;
+	int pixel_count = width * height;
+	int frames = 100;
+
+	uint32_t* colors = malloc(sizeof(uint32_t) * pixel_count);
+	uint8_t* indices = malloc(pixel_count);
+	if (!colors || !indices) {
+		free(colors);
+		free(indices);
+		return;
+	}
+
+	uint64_t start = timing_now();
+	for (int f = 0; f < frames; f++) {
+		for (int i = 0; i < pixel_count; i++) {
+			colors[i] = 0xFF000000 | f;
+		}
+	}
+	double clear_color_ms = timing_ms_between(start, timing_now()) / frames;
+
+	start = timing_now();
+	for (int f = 0; f < frames; f++) {
+		memset(indices, f, pixel_count);
+	}
+	double clear_index_ms = timing_ms_between(start, timing_now()) / frames;
+
+	// A few colors in runs, like a game frame.
+	uint32_t palette_colors[PALETTE_SIZE];
+	for (int i = 0; i < PALETTE_SIZE; i++) {
+		palette_colors[i] = 0xFF000000 | (i * 2654435761u);
+	}
+	for (int i = 0; i < pixel_count; i++) {
+		indices[i] = (i / 16) % 6;
+	}
+
+	double kernel_ms[2];
+	for (int kernel = 0; kernel < 2; kernel++) {
+		start = timing_now();
+		for (int f = 0; f < frames; f++) {
+			if (kernel == 0) {
+				expand_palette_scalar(colors, indices, pixel_count, palette_colors);
+			} else {
+				expand_palette(colors, indices, pixel_count, palette_colors);
+			}
+		}
+		kernel_ms[kernel] = timing_ms_between(start, timing_now()) / frames;
+	}
+
+	fprintf(stderr, "One %dx%d frame:\n", width, height);
+	fprintf(stderr, "  clear 32-bit colors:  %.3fms\n", clear_color_ms);
+	fprintf(stderr, "  clear 8-bit indices:  %.3fms\n", clear_index_ms);
+	fprintf(stderr, "  expand, scalar:       %.3fms\n", kernel_ms[0]);
+	// expand_palette() picks its kernel at runtime, so say which one ran.
+	fprintf(stderr, "  expand, in use:       %.3fms (%s)\n", kernel_ms[1], expand_palette_kernel_name());
+
+	free(colors);
+	free(indices);
+}
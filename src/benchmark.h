@@ -0,0 +1,12 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdint.h>
+
+int benchmark_render_drivers(uint32_t renderer_flags);
+void benchmark_raster(void);
+void benchmark_blend(void);
+void benchmark_entities(void);
+void benchmark_palette(void);
+
+#endif
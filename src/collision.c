@@ -0,0 +1,91 @@
+#include <math.h>
+#include "collision.h"
+
+// Boxes are allowed to overlap a cell by this much without counting as being
+// in it. Float rounding can leave a box a hair past a wall it was stopped at.
+#define CONTACT_EPSILON 0.0001f
+
+// Anything outside the level is solid, so nothing can leave it.
+bool is_wall(const int walls[LEVEL_HEIGHT][LEVEL_WIDTH], int x, int y) {
+	if (x < 0 || y < 0 || x >= LEVEL_WIDTH || y >= LEVEL_HEIGHT) {
+		return true;
+	}
+	return walls[y][x] == 1;
+}
+
+/**
+ * Moves the box along one axis, walking only the columns (or rows) of cells
+ * its leading edge crosses. Each of those is checked against the cells the box
+ * spans on the other axis, so the cost depends on how far the box moves and
+ * how big it is, never on the size of the level.
+ *
+ * Returns how far the box can move, which is up to the first wall it would
+ * touch.
+ */
+float sweep_axis(
+	const int walls[LEVEL_HEIGHT][LEVEL_WIDTH],
+	float leading_min,
+	float leading_max,
+	float side_min,
+	float side_max,
+	float distance,
+	bool vertical,
+	bool* hit
+) {
+	*hit = false;
+	if (distance == 0) {
+		return 0;
+	}
+
+	int first_side = (int) floorf(side_min + CONTACT_EPSILON);
+	int last_side = (int) ceilf(side_max - CONTACT_EPSILON) - 1;
+
+	if (distance > 0) {
+		// Cells whose near edge is at or ahead of the leading edge and behind
+		// where it ends up.
+		int first = (int) ceilf(leading_max - CONTACT_EPSILON);
+		int last = (int) ceilf(leading_max + distance) - 1;
+		for (int cell = first; cell <= last; cell++) {
+			for (int side = first_side; side <= last_side; side++) {
+				bool wall = vertical ? is_wall(walls, side, cell) : is_wall(walls, cell, side);
+				if (wall) {
+					*hit = true;
+					float contact = cell - leading_max;
+					return contact > 0 ? contact : 0;
+				}
+			}
+		}
+	} else {
+		int first = (int) floorf(leading_min + CONTACT_EPSILON) - 1;
+		int last = (int) floorf(leading_min + distance);
+		for (int cell = first; cell >= last; cell--) {
+			for (int side = first_side; side <= last_side; side++) {
+				bool wall = vertical ? is_wall(walls, side, cell) : is_wall(walls, cell, side);
+				if (wall) {
+					*hit = true;
+					float contact = (cell + 1) - leading_min;
+					return contact < 0 ? contact : 0;
+				}
+			}
+		}
+	}
+	return distance;
+}
+
+/**
+ * Sweeps the box through the wall grid one axis at a time, x first. A move
+ * of any length checks every cell on the way, so nothing can skip through a
+ * wall between ticks, and the returned motion stops the box flush against
+ * whatever it hit.
+ */
+sweep_t sweep_box(const int walls[LEVEL_HEIGHT][LEVEL_WIDTH], box_t box, vec2_t motion) {
+	sweep_t sweep;
+
+	sweep.motion.x = sweep_axis(walls, box.min.x, box.max.x, box.min.y, box.max.y, motion.x, false, &sweep.hit_x);
+	box.min.x += sweep.motion.x;
+	box.max.x += sweep.motion.x;
+
+	sweep.motion.y = sweep_axis(walls, box.min.y, box.max.y, box.min.x, box.max.x, motion.y, true, &sweep.hit_y);
+
+	return sweep;
+}
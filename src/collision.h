@@ -0,0 +1,24 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <stdbool.h>
+#include "level.h"
+#include "vector.h"
+
+// An axis-aligned box in level cells. Covers [min, max) on both axes.
+typedef struct {
+	vec2_t min;
+	vec2_t max;
+} box_t;
+
+typedef struct {
+	// How far the box can actually move before touching a wall.
+	vec2_t motion;
+	bool hit_x;
+	bool hit_y;
+} sweep_t;
+
+bool is_wall(const int walls[LEVEL_HEIGHT][LEVEL_WIDTH], int x, int y);
+sweep_t sweep_box(const int walls[LEVEL_HEIGHT][LEVEL_WIDTH], box_t box, vec2_t motion);
+
+#endif
@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+#include "compositor.h"
+#include "display.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+layer_t layers[LAYER_COUNT];
+layer_id_t current_layer = LAYER_BACKGROUND;
+
+// A flat color blended over the whole frame after the layers, like the red
+// flash when the player hits a wall.
+uint32_t screen_tint_color = 0;
+uint8_t screen_tint_opacity = 0;
+
+bool create_layers(void) {
+	for (int i = 0; i < LAYER_COUNT; i++) {
+		// Start fully transparent.
+		layers[i].pixels = calloc(window_width * window_height, sizeof(uint32_t));
+		layers[i].opacity = 255;
+		layers[i].drawn_top = window_height;
+		layers[i].drawn_bottom = -1;
+		if (!layers[i].pixels) {
+			destroy_layers();
+			return false;
+		}
+	}
+	return true;
+}
+
+void destroy_layers(void) {
+	for (int i = 0; i < LAYER_COUNT; i++) {
+		free(layers[i].pixels);
+		layers[i].pixels = NULL;
+	}
+}
+
+// Hands the drawn rows the draw functions have been tracking back to the
+// current layer.
+void save_drawn_rows(void) {
+	layers[current_layer].drawn_top = drawn_top;
+	layers[current_layer].drawn_bottom = drawn_bottom;
+}
+
+// Points color_buffer at the layer, so everything drawn from now on lands on
+// it.
+void select_layer(layer_id_t layer) {
+	save_drawn_rows();
+	current_layer = layer;
+	color_buffer = layers[layer].pixels;
+	drawn_top = layers[layer].drawn_top;
+	drawn_bottom = layers[layer].drawn_bottom;
+}
+
+// Trades the layer's pixels for a buffer drawn somewhere else, along with the
+// rows drawn in each. Afterwards the arguments hold the layer's old buffer.
+void swap_layer_pixels(layer_id_t layer, uint32_t** pixels, int* top, int* bottom) {
+	save_drawn_rows();
+
+	uint32_t* swapped_pixels = layers[layer].pixels;
+	int swapped_top = layers[layer].drawn_top;
+	int swapped_bottom = layers[layer].drawn_bottom;
+	layers[layer].pixels = *pixels;
+	layers[layer].drawn_top = *top;
+	layers[layer].drawn_bottom = *bottom;
+	*pixels = swapped_pixels;
+	*top = swapped_top;
+	*bottom = swapped_bottom;
+
+	// The draw functions may have been pointed at the buffer that just left.
+	color_buffer = layers[current_layer].pixels;
+	drawn_top = layers[current_layer].drawn_top;
+	drawn_bottom = layers[current_layer].drawn_bottom;
+}
+
+// Makes the rows of the current layer that were drawn to transparent again.
+void clear_layer(void) {
+	if (drawn_top <= drawn_bottom) {
+		int row_count = drawn_bottom - drawn_top + 1;
+		memset(&color_buffer[drawn_top * window_width], 0, sizeof(uint32_t) * window_width * row_count);
+	}
+	drawn_top = window_height;
+	drawn_bottom = -1;
+}
+
+void set_screen_tint(uint32_t color, uint8_t opacity) {
+	screen_tint_color = color;
+	screen_tint_opacity = opacity;
+}
+
+// Divides by 255 with rounding for any x up to 255 * 255.
+uint32_t divide_by_255(uint32_t x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+/**
+ * Source-over blending onto an opaque destination, one pixel at a time. The
+ * result is always opaque, so the destination alpha is never read.
+ */
+void blend_pixels_scalar(uint32_t* destination, const uint32_t* source, int count, uint8_t opacity) {
+	for (int i = 0; i < count; i++) {
+		uint32_t src = source[i];
+		uint32_t alpha = divide_by_255((src >> 24) * opacity);
+		if (alpha == 0) {
+			continue;
+		}
+		uint32_t dst = destination[i];
+		uint32_t result = 0xFF000000;
+		for (int shift = 0; shift < 24; shift += 8) {
+			uint32_t s = (src >> shift) & 0xFF;
+			uint32_t d = (dst >> shift) & 0xFF;
+			result |= divide_by_255(s * alpha + d * (255 - alpha)) << shift;
+		}
+		destination[i] = result;
+	}
+}
+
+#ifdef __SSE2__
+// Same rounding divide as divide_by_255(), on eight 16 bit lanes.
+__m128i divide_by_255_epi16(__m128i x) {
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Blends two pixels that have been widened to 16 bits per channel.
+__m128i blend_two_pixels(__m128i src, __m128i dst, __m128i opacity) {
+	// Copy each pixel's alpha into all four of its channels.
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	alpha = divide_by_255_epi16(_mm_mullo_epi16(alpha, opacity));
+	__m128i inverse_alpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+	__m128i sum = _mm_add_epi16(_mm_mullo_epi16(src, alpha), _mm_mullo_epi16(dst, inverse_alpha));
+	return divide_by_255_epi16(sum);
+}
+#endif
+
+/**
+ * Blends source over destination four pixels at a time. Blocks of four that
+ * are fully transparent are skipped without touching the destination, which
+ * is most of every layer but the background. With full layer opacity, blocks
+ * that are fully opaque are copied instead of blended.
+ */
+void blend_pixels(uint32_t* destination, const uint32_t* source, int count, uint8_t opacity) {
+	int i = 0;
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+	__m128i alpha_mask = _mm_set1_epi32((int) 0xFF000000);
+	__m128i opaque_alpha = _mm_set1_epi32((int) 0xFF000000);
+	__m128i layer_opacity = _mm_set1_epi16(opacity);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i src = _mm_loadu_si128((const __m128i*) &source[i]);
+		__m128i src_alpha = _mm_and_si128(src, alpha_mask);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(src_alpha, zero)) == 0xFFFF) {
+			continue;
+		}
+		if (opacity == 255 && _mm_movemask_epi8(_mm_cmpeq_epi32(src_alpha, opaque_alpha)) == 0xFFFF) {
+			_mm_storeu_si128((__m128i*) &destination[i], src);
+			continue;
+		}
+
+		__m128i dst = _mm_loadu_si128((const __m128i*) &destination[i]);
+		__m128i low = blend_two_pixels(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dst, zero), layer_opacity);
+		__m128i high = blend_two_pixels(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dst, zero), layer_opacity);
+		__m128i result = _mm_or_si128(_mm_packus_epi16(low, high), opaque_alpha);
+		_mm_storeu_si128((__m128i*) &destination[i], result);
+	}
+#endif
+	blend_pixels_scalar(&destination[i], &source[i], count - i, opacity);
+}
+
+void tint_pixels(uint32_t* pixels, int count, uint32_t color, uint8_t opacity) {
+	// Blend from a small block of the tint color so the same kernel does the
+	// work.
+	uint32_t block[64];
+	for (int i = 0; i < 64; i++) {
+		block[i] = color | 0xFF000000;
+	}
+	for (int i = 0; i < count; i += 64) {
+		int block_count = count - i < 64 ? count - i : 64;
+		blend_pixels(&pixels[i], block, block_count, opacity);
+	}
+}
+
+/**
+ * Builds the finished frame in output: the background is copied and the
+ * drawn rows of every other visible layer are blended over it in order.
+ */
+void composite_layers(uint32_t* output) {
+	int pixel_count = window_width * window_height;
+
+	save_drawn_rows();
+
+	memcpy(output, layers[LAYER_BACKGROUND].pixels, sizeof(uint32_t) * pixel_count);
+
+	for (int i = LAYER_BACKGROUND + 1; i < LAYER_COUNT; i++) {
+		layer_t* layer = &layers[i];
+		if (layer->opacity == 0 || layer->drawn_top > layer->drawn_bottom) {
+			continue;
+		}
+		int offset = layer->drawn_top * window_width;
+		int count = (layer->drawn_bottom - layer->drawn_top + 1) * window_width;
+		blend_pixels(&output[offset], &layer->pixels[offset], count, layer->opacity);
+	}
+
+	if (screen_tint_opacity > 0) {
+		tint_pixels(output, pixel_count, screen_tint_color, screen_tint_opacity);
+	}
+}
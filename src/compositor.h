@@ -0,0 +1,39 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+	// Opaque, everything else is blended on top of it.
+	LAYER_BACKGROUND,
+	LAYER_WALLS,
+	LAYER_ACTORS,
+	LAYER_HUD,
+	LAYER_COUNT,
+} layer_id_t;
+
+typedef struct {
+	uint32_t* pixels;
+	// Multiplied with each pixel's own alpha. A layer at 0 is skipped
+	// entirely.
+	uint8_t opacity;
+	// Rows that have been drawn to since the layer was last cleared. Only
+	// these are cleared and blended.
+	int drawn_top;
+	int drawn_bottom;
+} layer_t;
+
+extern layer_t layers[LAYER_COUNT];
+
+bool create_layers(void);
+void destroy_layers(void);
+void select_layer(layer_id_t layer);
+void clear_layer(void);
+void swap_layer_pixels(layer_id_t layer, uint32_t** pixels, int* top, int* bottom);
+void set_screen_tint(uint32_t color, uint8_t opacity);
+void composite_layers(uint32_t* output);
+void blend_pixels(uint32_t* destination, const uint32_t* source, int count, uint8_t opacity);
+void blend_pixels_scalar(uint32_t* destination, const uint32_t* source, int count, uint8_t opacity);
+
+#endif
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+
+config_t config = {
+	.render_driver = NULL,
+	.present_mode = PRESENT_MODE_DEFAULT,
+	.renderer = RENDERER_SOFTWARE,
+	.benchmark_drivers = false,
+	.list_drivers = false,
+	.show_hud = false,
+	.idle = true,
+	.startup_report = false,
+	.palette_mode = false,
+	.benchmark_raster = false,
+	.benchmark_blend = false,
+	.benchmark_entities = false,
+	.benchmark_palette = false,
+};
+
+void print_usage(FILE* out, const char* program) {
+	fprintf(
+		out,
+		"Usage: %s [options]\n"
+		"  --help                      Print this and exit.\n"
+		"  --render-driver <name>      Use this SDL render driver, e.g. opengl or software.\n"
+		"  --present-mode <mode>       vsync or immediate.\n"
+		"  --renderer <renderer>       software or sprites.\n"
+		"  --benchmark-drivers         Time every render driver at startup and use the fastest.\n"
+		"  --list-drivers              Print the available render drivers and exit.\n"
+		"  --hud                       Show the performance HUD. F1 toggles it in game.\n"
+		"  --no-idle                   Keep drawing frames even when nothing changes.\n"
+		"  --startup-report            Print the time to first frame, stage by stage.\n"
+		"  --palette                   Draw into an 8-bit palette frame instead of color layers.\n"
+		"  --benchmark-raster          Time the triangle drawing paths and exit.\n"
+		"  --benchmark-blend           Time the layer blending kernels and exit.\n"
+		"  --benchmark-entities        Time 100k entities updating and colliding and exit.\n"
+		"  --benchmark-palette         Time the palette expansion kernels and exit.\n",
+		program
+	);
+}
+
+// Returns false if the arguments don't make sense and the game shouldn't start.
+bool parse_config(int argc, char* argv[]) {
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		// Options that take a value read it from the next argument.
+		const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "--help") == 0) {
+			// Asked for, so it goes to stdout and isn't an error.
+			print_usage(stdout, argv[0]);
+			exit(0);
+		} else if (strcmp(arg, "--render-driver") == 0 && value) {
+			config.render_driver = value;
+			i++;
+		} else if (strcmp(arg, "--present-mode") == 0 && value) {
+			if (strcmp(value, "vsync") == 0) {
+				config.present_mode = PRESENT_MODE_VSYNC;
+			} else if (strcmp(value, "immediate") == 0) {
+				config.present_mode = PRESENT_MODE_IMMEDIATE;
+			} else {
+				fprintf(stderr, "Unknown present mode \"%s\".\n", value);
+				return false;
+			}
+			i++;
+		} else if (strcmp(arg, "--renderer") == 0 && value) {
+			if (strcmp(value, "software") == 0) {
+				config.renderer = RENDERER_SOFTWARE;
+			} else if (strcmp(value, "sprites") == 0) {
+				config.renderer = RENDERER_SPRITES;
+			} else {
+				fprintf(stderr, "Unknown renderer \"%s\".\n", value);
+				return false;
+			}
+			i++;
+		} else if (strcmp(arg, "--benchmark-drivers") == 0) {
+			config.benchmark_drivers = true;
+		} else if (strcmp(arg, "--list-drivers") == 0) {
+			config.list_drivers = true;
+		} else if (strcmp(arg, "--hud") == 0) {
+			config.show_hud = true;
+		} else if (strcmp(arg, "--no-idle") == 0) {
+			config.idle = false;
+		} else if (strcmp(arg, "--startup-report") == 0) {
+			config.startup_report = true;
+		} else if (strcmp(arg, "--palette") == 0) {
+			config.palette_mode = true;
+		} else if (strcmp(arg, "--benchmark-raster") == 0) {
+			config.benchmark_raster = true;
+		} else if (strcmp(arg, "--benchmark-blend") == 0) {
+			config.benchmark_blend = true;
+		} else if (strcmp(arg, "--benchmark-entities") == 0) {
+			config.benchmark_entities = true;
+		} else if (strcmp(arg, "--benchmark-palette") == 0) {
+			config.benchmark_palette = true;
+		} else {
+			print_usage(stderr, argv[0]);
+			return false;
+		}
+	}
+
+	if (config.palette_mode && config.renderer != RENDERER_SOFTWARE) {
+		fprintf(stderr, "--palette only works with the software renderer.\n");
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,57 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdbool.h>
+
+typedef enum {
+	// Whatever the render driver does by default.
+	PRESENT_MODE_DEFAULT,
+	// Wait for vertical sync before presenting.
+	PRESENT_MODE_VSYNC,
+	// Present as soon as the frame is ready.
+	PRESENT_MODE_IMMEDIATE,
+} present_mode_t;
+
+typedef enum {
+	// Draw pixels in software and upload the whole frame every frame.
+	RENDERER_SOFTWARE,
+	// Copy pre-baked textures with the SDL renderer. Nothing is uploaded
+	// per frame.
+	RENDERER_SPRITES,
+} renderer_t;
+
+typedef struct {
+	// Name of the SDL render driver to use, like "opengl" or "software". NULL
+	// lets SDL pick.
+	const char* render_driver;
+	present_mode_t present_mode;
+	renderer_t renderer;
+	// Time a few frames on every available render driver at startup and use
+	// the fastest one. Ignored when a render driver is named.
+	bool benchmark_drivers;
+	bool list_drivers;
+	// Start with the performance HUD showing. F1 toggles it either way.
+	bool show_hud;
+	// Wait for events instead of drawing when nothing on screen would change.
+	bool idle;
+	// Print how long each stage of startup took once the first frame is up.
+	bool startup_report;
+	// Draw palette indices into an 8-bit frame instead of colors into the
+	// compositor's layers.
+	bool palette_mode;
+	// Time the player triangle drawn as lines against the filled rasterizer
+	// and exit.
+	bool benchmark_raster;
+	// Time blending a full frame with and without the vector kernel and exit.
+	bool benchmark_blend;
+	// Run 100k entities for a while, report the cost per tick and exit.
+	bool benchmark_entities;
+	// Time expanding a full frame of palette indices and exit.
+	bool benchmark_palette;
+} config_t;
+
+extern config_t config;
+
+bool parse_config(int argc, char* argv[]);
+
+#endif
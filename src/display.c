@@ -1,9 +1,25 @@
 #include "display.h"
+#include "benchmark.h"
+#include "config.h"
+#include "palette.h"
+#include "sprites.h"
+#include "timing.h"
 
 SDL_Window* window = NULL;
 SDL_Renderer* renderer = NULL;
+// Whatever the draw functions are drawing into right now, usually one of the
+// compositor's layers.
 uint32_t* color_buffer = NULL;
+// The finished frame that gets uploaded to the screen.
+uint32_t* frame_buffer = NULL;
+// Set in palette mode. The draw functions write palette indices here instead
+// of colors into color_buffer, and the upload expands them.
+uint8_t* index_buffer = NULL;
 SDL_Texture* color_buffer_texture = NULL;
+// The range of rows in color_buffer that has been drawn to. Empty when top is
+// below bottom.
+int drawn_top = 0;
+int drawn_bottom = -1;
 int window_width = 800;
 int window_height = 600;
 int cell_size = 20;
@@ -11,15 +27,18 @@ uint32_t white = 0xFFCCCCCC;
 uint32_t red = 0xFFFF0000;
 
 bool initialize_window(void) {
-	// What bits of hardware do you want to initialize?
-	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
-		fprintf(stderr, "Error initializing SDL.\n");
+	// What bits of hardware do you want to initialize? Only video, which
+	// brings events with it. Audio, joysticks and the rest take a while to
+	// start and the game doesn't use them. Anything that needs one later can
+	// start it then with SDL_InitSubSystem().
+	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+		fprintf(stderr, "Error initializing SDL: %s\n", SDL_GetError());
 		return false;
 	}
+	startup_stage_done("SDL init");
 
 	window = SDL_CreateWindow(
-		// No window title
-		NULL,
+		"Flashlight Game",
 		// window X
 		SDL_WINDOWPOS_CENTERED,
 		// window Y
@@ -36,44 +55,127 @@ bool initialize_window(void) {
 		fprintf(stderr, "Error creating SDL window.\n");
 		return false;
 	}
+	startup_stage_done("window");
+
+	// Index of rendering driver to initialize.
+	// -1 means first one that supports requested flags
+	int driver = -1;
+	if (config.render_driver) {
+		driver = find_render_driver(config.render_driver);
+		if (driver == -1) {
+			fprintf(stderr, "Unknown render driver \"%s\".\n", config.render_driver);
+			list_render_drivers();
+			return false;
+		}
+	} else if (config.benchmark_drivers) {
+		fprintf(stderr, "Benchmarking render drivers:\n");
+		// Vsync would cap every driver at the refresh rate, so benchmark
+		// without it and apply the present mode afterwards.
+		driver = benchmark_render_drivers(0);
+	}
+
+	if (config.present_mode == PRESENT_MODE_IMMEDIATE) {
+		// Some drivers turn vsync on by default, so ask for it to be off
+		// rather than just not asking for it.
+		SDL_SetHint(SDL_HINT_RENDER_VSYNC, "0");
+	}
 
 	renderer = SDL_CreateRenderer(
 		window,
-		// Index of rendering driver to initialize.
-		// -1 means first one that supports requested flags
-		-1,
+		driver,
 		// Renderer Flags
 		// 0 is none
-		0
+		config.present_mode == PRESENT_MODE_VSYNC ? SDL_RENDERER_PRESENTVSYNC : 0
 	);
 
 	if (!renderer) {
 		fprintf(stderr, "Error creating SDL renderer.\n");
 		return false;
 	}
+	startup_stage_done("renderer");
+
+	SDL_RendererInfo info;
+	if (config.benchmark_drivers && SDL_GetRendererInfo(renderer, &info) == 0) {
+		fprintf(stderr, "Using render driver %s.\n", info.name);
+	}
 
 	return true;
 }
 
+// Returns the index of the render driver with the given name, or -1 if SDL
+// doesn't have one.
+int find_render_driver(const char* name) {
+	for (int driver = 0; driver < SDL_GetNumRenderDrivers(); driver++) {
+		SDL_RendererInfo info;
+		if (SDL_GetRenderDriverInfo(driver, &info) == 0 && SDL_strcasecmp(info.name, name) == 0) {
+			return driver;
+		}
+	}
+	return -1;
+}
+
+void list_render_drivers(void) {
+	fprintf(stderr, "Available render drivers:\n");
+	for (int driver = 0; driver < SDL_GetNumRenderDrivers(); driver++) {
+		SDL_RendererInfo info;
+		if (SDL_GetRenderDriverInfo(driver, &info) == 0) {
+			fprintf(stderr, "  %s\n", info.name);
+		}
+	}
+}
+
 
 void clear_color_buffer(uint32_t color) {
+	if (index_buffer) {
+		memset(index_buffer, palette_index(color), window_width * window_height);
+		mark_rows_drawn(0, window_height - 1);
+		return;
+	}
 	for (int i = 0; i < window_width * window_height; i++) {
 		color_buffer[i] = color;
 	}
+	mark_rows_drawn(0, window_height - 1);
+}
+
+void mark_rows_drawn(int top, int bottom) {
+	if (top < 0) top = 0;
+	if (bottom > window_height - 1) bottom = window_height - 1;
+	if (top < drawn_top) drawn_top = top;
+	if (bottom > drawn_bottom) drawn_bottom = bottom;
 }
 
-// Copies the color buffer to a texture and copies the texture to the current rendering target.
+// Expands the palette indices straight into the texture's memory, so the full
+// color frame is only ever written once.
+void upload_index_buffer(void) {
+	void* pixels;
+	int pitch;
+	if (SDL_LockTexture(color_buffer_texture, NULL, &pixels, &pitch) != 0) {
+		return;
+	}
+	for (int y = 0; y < window_height; y++) {
+		uint32_t* row = (uint32_t*) ((uint8_t*) pixels + y * pitch);
+		expand_palette(row, &index_buffer[y * window_width], window_width, screen_palette);
+	}
+	SDL_UnlockTexture(color_buffer_texture);
+}
+
+// Copies the frame buffer to a texture and copies the texture to the current rendering target.
 void render_color_buffer(void) {
-	// Update the given texture rectangle with new pixel data.
-	SDL_UpdateTexture(
-		color_buffer_texture,
-		// Optionally used to render just a part of the texture. Think of
-		// sprite sheets.
-		NULL,
-		color_buffer,
-		// "Texture pitch" or size of each row in texture.
-		(int)(window_width * sizeof(uint32_t))
-	);
+	if (index_buffer) {
+		upload_index_buffer();
+	} else {
+		// Update the given texture rectangle with new pixel data.
+		SDL_UpdateTexture(
+			color_buffer_texture,
+			// Optionally used to render just a part of the texture. Think of
+			// sprite sheets.
+			NULL,
+			frame_buffer,
+			// "Texture pitch" or size of each row in texture.
+			(int)(window_width * sizeof(uint32_t))
+		);
+	}
+	frame_count_upload(window_width * window_height);
 	// SDL2 docs: "Copy a portion of the texture to the current rendering target."
 	// We are copying the color buffer's texture to the rendering target.
 	SDL_RenderCopy(
@@ -87,28 +189,71 @@ void render_color_buffer(void) {
 
 void draw_pixel(int x, int y, uint32_t color) {
 	if (x < window_width && y < window_height) {
-		color_buffer[(y*window_width)+x] = color;
+		if (index_buffer) {
+			index_buffer[(y*window_width)+x] = palette_index(color);
+		} else {
+			color_buffer[(y*window_width)+x] = color;
+		}
+		if (y < drawn_top) drawn_top = y;
+		if (y > drawn_bottom) drawn_bottom = y;
 	}
 }
 
+// Only visits the dots, not every pixel, since it's drawn during startup.
 void draw_grid(void) {
-	for (int row = 0; row < window_height; row++) {
-		for (int col = 0; col < window_width; col++) {
-			if (row % 20 == 0 && col % 20 == 0) {
-				draw_pixel(col, row, 0xFF555555);
-			}
+	for (int row = 0; row < window_height; row += 20) {
+		for (int col = 0; col < window_width; col += 20) {
+			draw_pixel(col, row, 0xFF555555);
 		}
 	}
 }
 
 void draw_rect(int x, int y, int width, int height, uint32_t color) {
-	for (int curr_y = y; curr_y < y + height; curr_y++) {
-		for (int curr_x = x; curr_x < x + width; curr_x++) {
-			draw_pixel(curr_x, curr_y, color);
+	if (sprites_active) {
+		fill_sprite_rect(x, y, width, height, color);
+		return;
+	}
+	if (index_buffer) {
+		fill_index_rect(x, y, width, height, palette_index(color));
+		return;
+	}
+	fill_color_rect(x, y, width, height, color);
+}
+
+// draw_rect() into color_buffer. Clipped to the screen once, then filled a
+// row at a time.
+void fill_color_rect(int x, int y, int width, int height, uint32_t color) {
+	int right = x + width < window_width ? x + width : window_width;
+	int bottom = y + height < window_height ? y + height : window_height;
+	if (x < 0) x = 0;
+	if (y < 0) y = 0;
+	if (x >= right || y >= bottom) {
+		return;
+	}
+	mark_rows_drawn(y, bottom - 1);
+	for (int row = y; row < bottom; row++) {
+		uint32_t* pixel = &color_buffer[row * window_width + x];
+		for (int i = 0; i < right - x; i++) {
+			pixel[i] = color;
 		}
 	}
 }
 
+// Palette mode's draw_rect, filling whole rows of indices at once.
+void fill_index_rect(int x, int y, int width, int height, uint8_t index) {
+	int right = x + width < window_width ? x + width : window_width;
+	int bottom = y + height < window_height ? y + height : window_height;
+	if (x < 0) x = 0;
+	if (y < 0) y = 0;
+	if (x >= right || y >= bottom) {
+		return;
+	}
+	mark_rows_drawn(y, bottom - 1);
+	for (int row = y; row < bottom; row++) {
+		memset(&index_buffer[row * window_width + x], index, right - x);
+	}
+}
+
 /**
  * How do we draw a line?
  * Let's say our start is 2,0 and end is 5,5.
@@ -147,15 +292,236 @@ void draw_line(vec2_t start, vec2_t finish, uint32_t color) {
 	}
 };
 
-void draw_walls(const int walls[20][20], level_state_t level_state) {
+// Triangle vertices are snapped to a fixed-point grid with this many bits
+// below the pixel, so 1/16th of a pixel.
+#define SUBPIXEL_BITS 4
+// Vertices further than this from the origin could overflow the edge
+// functions, so triangles that reach that far aren't drawn at all.
+#define MAX_TRIANGLE_COORDINATE (1 << 20)
+
+typedef struct {
+	int64_t x;
+	int64_t y;
+} fixed_point_t;
+
+fixed_point_t to_fixed_point(vec2_t point) {
+	fixed_point_t fixed = {
+		.x = llroundf(point.x * (1 << SUBPIXEL_BITS)),
+		.y = llroundf(point.y * (1 << SUBPIXEL_BITS)),
+	};
+	return fixed;
+}
+
+// Which side of the edge from a to b is p on? Positive means the same side as
+// the inside of a clockwise (on screen) triangle.
+int64_t edge_function(fixed_point_t a, fixed_point_t b, fixed_point_t p) {
+	return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+int64_t min3(int64_t a, int64_t b, int64_t c) {
+	int64_t min = a < b ? a : b;
+	return min < c ? min : c;
+}
+
+int64_t max3(int64_t a, int64_t b, int64_t c) {
+	int64_t max = a > b ? a : b;
+	return max > c ? max : c;
+}
+
+// With clockwise winding and y pointing down, left edges go up the screen and
+// top edges are flat and go right.
+bool is_top_left_edge(fixed_point_t a, fixed_point_t b) {
+	return (a.y == b.y && b.x > a.x) || b.y < a.y;
+}
+
+// One row of draw_filled_triangle(). w0, w1 and w2 are the edge values at
+// min_x and step0_x, step1_x and step2_x are how much they change per pixel.
+void fill_triangle_row(
+	uint32_t* row, int64_t min_x, int64_t max_x,
+	int64_t w0, int64_t w1, int64_t w2,
+	int64_t step0_x, int64_t step1_x, int64_t step2_x,
+	uint32_t color
+) {
+	int64_t x = min_x;
+	for (; x + 3 <= max_x; x += 4) {
+		for (int lane = 0; lane < 4; lane++) {
+			int64_t e0 = w0 + lane * step0_x;
+			int64_t e1 = w1 + lane * step1_x;
+			int64_t e2 = w2 + lane * step2_x;
+			// All three are inside when none of the sign bits are set.
+			if ((e0 | e1 | e2) >= 0) {
+				row[x + lane] = color;
+			}
+		}
+		w0 += 4 * step0_x;
+		w1 += 4 * step1_x;
+		w2 += 4 * step2_x;
+	}
+	for (; x <= max_x; x++) {
+		if ((w0 | w1 | w2) >= 0) {
+			row[x] = color;
+		}
+		w0 += step0_x;
+		w1 += step1_x;
+		w2 += step2_x;
+	}
+}
+
+// The same row in palette mode, storing an index byte instead of a color.
+void fill_triangle_row_indices(
+	uint8_t* row, int64_t min_x, int64_t max_x,
+	int64_t w0, int64_t w1, int64_t w2,
+	int64_t step0_x, int64_t step1_x, int64_t step2_x,
+	uint8_t index
+) {
+	int64_t x = min_x;
+	for (; x + 3 <= max_x; x += 4) {
+		for (int lane = 0; lane < 4; lane++) {
+			int64_t e0 = w0 + lane * step0_x;
+			int64_t e1 = w1 + lane * step1_x;
+			int64_t e2 = w2 + lane * step2_x;
+			if ((e0 | e1 | e2) >= 0) {
+				row[x + lane] = index;
+			}
+		}
+		w0 += 4 * step0_x;
+		w1 += 4 * step1_x;
+		w2 += 4 * step2_x;
+	}
+	for (; x <= max_x; x++) {
+		if ((w0 | w1 | w2) >= 0) {
+			row[x] = index;
+		}
+		w0 += step0_x;
+		w1 += step1_x;
+		w2 += step2_x;
+	}
+}
+
+/**
+ * Fills a triangle by walking its bounding box and testing each pixel against
+ * the three edge functions. Everything is integer math on fixed-point
+ * vertices, so the result doesn't depend on float rounding.
+ *
+ * Pixels are sampled at their integer coordinates, the same spot draw_line()
+ * and draw_pixel() treat as the pixel.
+ *
+ * A pixel exactly on an edge is only filled if that edge is a top or left
+ * edge. That way two triangles sharing an edge never both fill the pixels on
+ * it. The rule is folded into the edge values up front by subtracting one from
+ * the other edges, so the inner loop only has to check for "not negative".
+ *
+ * The inner loop steps four pixels at a time with the edge values for each
+ * lane computed from the same starting value, which the compiler can turn
+ * into vector instructions.
+ */
+void draw_filled_triangle(vec2_t a, vec2_t b, vec2_t c, uint32_t color) {
+	float limit = MAX_TRIANGLE_COORDINATE;
+	vec2_t vertices[3] = { a, b, c };
+	for (int i = 0; i < 3; i++) {
+		if (!(fabsf(vertices[i].x) < limit && fabsf(vertices[i].y) < limit)) {
+			return;
+		}
+	}
+
+	fixed_point_t v0 = to_fixed_point(a);
+	fixed_point_t v1 = to_fixed_point(b);
+	fixed_point_t v2 = to_fixed_point(c);
+
+	int64_t area = edge_function(v0, v1, v2);
+	if (area == 0) {
+		return;
+	}
+	// Make the winding clockwise so inside is always positive.
+	if (area < 0) {
+		fixed_point_t swap = v1;
+		v1 = v2;
+		v2 = swap;
+	}
+
+	// Bounding box in whole pixels, rounding inward, clipped to the window.
+	// Shifting rounds toward negative infinity, which is what we want here.
+	int64_t one = 1 << SUBPIXEL_BITS;
+	int64_t min_x = (min3(v0.x, v1.x, v2.x) + one - 1) >> SUBPIXEL_BITS;
+	int64_t min_y = (min3(v0.y, v1.y, v2.y) + one - 1) >> SUBPIXEL_BITS;
+	int64_t max_x = max3(v0.x, v1.x, v2.x) >> SUBPIXEL_BITS;
+	int64_t max_y = max3(v0.y, v1.y, v2.y) >> SUBPIXEL_BITS;
+	if (min_x < 0) min_x = 0;
+	if (min_y < 0) min_y = 0;
+	if (max_x > window_width - 1) max_x = window_width - 1;
+	if (max_y > window_height - 1) max_y = window_height - 1;
+	if (min_x > max_x || min_y > max_y) {
+		return;
+	}
+	mark_rows_drawn(min_y, max_y);
+
+	// Edge i is the edge opposite vertex i.
+	int64_t bias0 = is_top_left_edge(v1, v2) ? 0 : -1;
+	int64_t bias1 = is_top_left_edge(v2, v0) ? 0 : -1;
+	int64_t bias2 = is_top_left_edge(v0, v1) ? 0 : -1;
+
+	// How much each edge function changes moving one pixel right or down.
+	int64_t step0_x = -(v2.y - v1.y) * one;
+	int64_t step1_x = -(v0.y - v2.y) * one;
+	int64_t step2_x = -(v1.y - v0.y) * one;
+	int64_t step0_y = (v2.x - v1.x) * one;
+	int64_t step1_y = (v0.x - v2.x) * one;
+	int64_t step2_y = (v1.x - v0.x) * one;
+
+	fixed_point_t origin = { .x = min_x * one, .y = min_y * one };
+	int64_t row0 = edge_function(v1, v2, origin) + bias0;
+	int64_t row1 = edge_function(v2, v0, origin) + bias1;
+	int64_t row2 = edge_function(v0, v1, origin) + bias2;
+
+	uint8_t index = index_buffer ? palette_index(color) : 0;
+	for (int64_t y = min_y; y <= max_y; y++) {
+		if (index_buffer) {
+			fill_triangle_row_indices(&index_buffer[y * window_width], min_x, max_x, row0, row1, row2, step0_x, step1_x, step2_x, index);
+		} else {
+			fill_triangle_row(&color_buffer[y * window_width], min_x, max_x, row0, row1, row2, step0_x, step1_x, step2_x, color);
+		}
+		row0 += step0_y;
+		row1 += step1_y;
+		row2 += step2_y;
+	}
+}
+
+void draw_walls(const int walls[20][20]) {
+	if (index_buffer) {
+		// Walls get their own palette entry, so they can fade on their own.
+		int wall_padding = 2;
+		int wall_size = cell_size - (wall_padding * 2);
+		for (int y = 0; y < 20; y++) {
+			for (int x = 0; x < 20; x++) {
+				if (walls[y][x] == 1) {
+					fill_index_rect(x * cell_size + wall_padding, y * cell_size + wall_padding, wall_size, wall_size, PALETTE_WALLS);
+				}
+			}
+		}
+		return;
+	}
+	bake_walls(color_buffer, walls, &drawn_top, &drawn_bottom);
+}
+
+// Draws the walls into any screen-sized buffer, widening the given drawn rows
+// to cover them. It only touches its arguments, so the level prefetch worker
+// can bake the next level's walls while the game draws to color_buffer.
+void bake_walls(uint32_t* pixels, const int walls[20][20], int* top, int* bottom) {
 	int wall_padding = 2;
+	int wall_size = cell_size - (wall_padding * 2);
 	for (int y = 0; y < 20; y++) {
 		for (int x = 0; x < 20; x++) {
-			if (walls[y][x] == 1 && (!level_state.player_moved || level_state.player_collided || level_state.flashlight_on)) {
-				int wall_y = (y * cell_size) + wall_padding;
-				int wall_x = (x * cell_size) + wall_padding;
-				int wall_size = cell_size - (wall_padding * 2);
-				draw_rect(wall_x, wall_y, wall_size, wall_size, white);
+			if (walls[y][x] != 1) {
+				continue;
+			}
+			int wall_y = (y * cell_size) + wall_padding;
+			int wall_x = (x * cell_size) + wall_padding;
+			for (int row = wall_y; row < wall_y + wall_size && row < window_height; row++) {
+				for (int col = wall_x; col < wall_x + wall_size && col < window_width; col++) {
+					pixels[(row * window_width) + col] = white;
+				}
+				if (row < *top) *top = row;
+				if (row > *bottom) *bottom = row;
 			}
 		}
 	}
@@ -206,15 +572,120 @@ void draw_player(vec2_t player, level_state_t level_state) {
 		.x = (player.x * cell_size) + (cell_size / 2),
 		.y = player.y * cell_size + padding
 	};
-	draw_line(bottom_left, top_middle, player_color);
 	vec2_t bottom_right = {
 		.x = (player.x * cell_size) + cell_size - 1 - padding,
 		.y = (player.y * cell_size) + cell_size - 1 - padding,
 	};
-	draw_line(top_middle, bottom_right, player_color);
-	draw_line(bottom_right, bottom_left, player_color);
+	draw_filled_triangle(bottom_left, top_middle, bottom_right, player_color);
+}
+
+/**
+ * Where entity i's square goes on screen, clipped to the level. Returns false
+ * if none of it is inside the level, which is most of them when there are
+ * a lot, so those cost a couple of compares and nothing else.
+ */
+bool entity_rect(const entities_t* entities, int i, SDL_Rect* rect) {
+	int size = (int) (ENTITY_HALF_SIZE * 2 * cell_size);
+	int left = (int) floorf(entities->x[i] * cell_size) - size / 2;
+	int top = (int) floorf(entities->y[i] * cell_size) - size / 2;
+	int right = left + size;
+	int bottom = top + size;
+	if (left < 0) left = 0;
+	if (top < 0) top = 0;
+	if (right > LEVEL_WIDTH * cell_size) right = LEVEL_WIDTH * cell_size;
+	if (bottom > LEVEL_HEIGHT * cell_size) bottom = LEVEL_HEIGHT * cell_size;
+	if (left >= right || top >= bottom) {
+		return false;
+	}
+	rect->x = left;
+	rect->y = top;
+	rect->w = right - left;
+	rect->h = bottom - top;
+	return true;
 }
 
+// Hazards are red squares and pickups are white ones.
+void draw_entities(const entities_t* entities) {
+	SDL_Rect rect;
+	for (int i = 0; i < entities->count; i++) {
+		if (!entity_rect(entities, i, &rect)) {
+			continue;
+		}
+		uint32_t color = entities->kind[i] == ENTITY_HAZARD ? red : white;
+		draw_rect(rect.x, rect.y, rect.w, rect.h, color);
+	}
+}
+
+// The flashlight charge icons along the bottom of the level.
+int flashlight_icon[20][20] = {
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0 },
+	{ 0, 1, 1, 0, 1, 0, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0 },
+	{ 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
+	{ 0, 1, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
+	{ 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
+	{ 0, 1, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
+	{ 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0 },
+	{ 0, 1, 1, 0, 1, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+
+int used_flashlight_charge[20][20] = {
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0 },
+	{ 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0 },
+	{ 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0 },
+	{ 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0 },
+	{ 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0 },
+	{ 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0 },
+	{ 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+
+int unused_flashlight_charge[20][20] = {
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
+	{ 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0 },
+	{ 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0 },
+	{ 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0 },
+	{ 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0 },
+	{ 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0 },
+	{ 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+
 void draw_icon(int x, int y, int pixels[20][20], uint32_t color) {
 	for (int row = 0; row < 20; row++) {
 		for (int col = 0; col < 20; col++) {
@@ -230,73 +701,6 @@ void draw_flashlight_charges(level_state_t level_state, level_t level) {
 		return;
 	}
 
-	int flashlight_icon [20][20] = {
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 1, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0 },
-		{ 0, 1, 1, 0, 1, 0, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0 },
-		{ 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
-		{ 0, 1, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
-		{ 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
-		{ 0, 1, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
-		{ 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0 },
-		{ 0, 1, 1, 0, 1, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-	};
-	int used_flashlight_charge [20][20] = {
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0 },
-		{ 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0 },
-		{ 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0 },
-		{ 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0 },
-		{ 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0 },
-		{ 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0 },
-		{ 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0 },
-		{ 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-	};
-	int unused_flashlight_charge [20][20] = {
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
-		{ 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0 },
-		{ 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0 },
-		{ 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0 },
-		{ 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0 },
-		{ 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0 },
-		{ 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0 },
-		{ 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-	};
-	
 	vec2_t flashlight_ui_anchor = {
 		.x = 0,
 		.y = 20 * cell_size
@@ -318,7 +722,7 @@ void draw_flashlight_charges(level_state_t level_state, level_t level) {
 }
 
 void destroy_window(void) {
-	free(color_buffer);
+	free(frame_buffer);
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
 	SDL_Quit();
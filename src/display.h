@@ -4,27 +4,50 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <SDL2/SDL.h>
+#include "entity.h"
 #include "level.h"
 #include "vector.h"
 
 extern SDL_Window* window;
 extern SDL_Renderer* renderer;
 extern uint32_t* color_buffer;
+extern uint32_t* frame_buffer;
+extern uint8_t* index_buffer;
 extern SDL_Texture* color_buffer_texture;
 extern int window_width;
 extern int window_height;
+extern int drawn_top;
+extern int drawn_bottom;
+extern uint32_t white;
+extern uint32_t red;
+extern int cell_size;
+extern int flashlight_icon[20][20];
+extern int used_flashlight_charge[20][20];
+extern int unused_flashlight_charge[20][20];
 
 bool initialize_window(void);
+int find_render_driver(const char* name);
+void list_render_drivers(void);
+void mark_rows_drawn(int top, int bottom);
 void draw_grid(void);
 void draw_pixel(int x, int y, uint32_t color);
 void draw_rect(int x, int y, int width, int height, uint32_t color);
+void fill_index_rect(int x, int y, int width, int height, uint8_t index);
+void fill_color_rect(int x, int y, int width, int height, uint32_t color);
 void draw_line(vec2_t start, vec2_t finish, uint32_t color);
-void draw_walls(const int walls[20][20], level_state_t level_state);
+void draw_filled_triangle(vec2_t a, vec2_t b, vec2_t c, uint32_t color);
+void draw_walls(const int walls[20][20]);
+void bake_walls(uint32_t* pixels, const int walls[20][20], int* top, int* bottom);
 void draw_finish(vec2_t finish);
 void draw_player(vec2_t player, level_state_t level_state);
+void draw_icon(int x, int y, int pixels[20][20], uint32_t color);
 void draw_flashlight_charges(level_state_t level_state, level_t level);
+bool entity_rect(const entities_t* entities, int i, SDL_Rect* rect);
+void draw_entities(const entities_t* entities);
+void upload_index_buffer(void);
 void render_color_buffer(void);
 void clear_color_buffer(uint32_t color);
 void destroy_window(void);
@@ -0,0 +1,343 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "entity.h"
+
+bool create_entities(entities_t* entities, int capacity) {
+	entities->count = 0;
+	entities->capacity = capacity;
+	entities->x = malloc(sizeof(float) * capacity);
+	entities->y = malloc(sizeof(float) * capacity);
+	entities->velocity_x = malloc(sizeof(float) * capacity);
+	entities->velocity_y = malloc(sizeof(float) * capacity);
+	entities->kind = malloc(sizeof(uint8_t) * capacity);
+	entities->flags = malloc(sizeof(uint8_t) * capacity);
+	entities->spawn = malloc(sizeof(uint8_t) * capacity);
+
+	if (
+		!entities->x || !entities->y
+		|| !entities->velocity_x || !entities->velocity_y
+		|| !entities->kind || !entities->flags || !entities->spawn
+	) {
+		destroy_entities(entities);
+		return false;
+	}
+	return true;
+}
+
+void destroy_entities(entities_t* entities) {
+	free(entities->x);
+	free(entities->y);
+	free(entities->velocity_x);
+	free(entities->velocity_y);
+	free(entities->kind);
+	free(entities->flags);
+	free(entities->spawn);
+	memset(entities, 0, sizeof(*entities));
+}
+
+// Returns the new entity's index, or -1 if there's no room.
+int spawn_entity(entities_t* entities, entity_kind_t kind, vec2_t position, vec2_t velocity, uint8_t flags) {
+	if (entities->count == entities->capacity) {
+		return -1;
+	}
+	int i = entities->count;
+	entities->x[i] = position.x;
+	entities->y[i] = position.y;
+	entities->velocity_x[i] = velocity.x;
+	entities->velocity_y[i] = velocity.y;
+	entities->kind[i] = kind;
+	entities->flags[i] = flags;
+	entities->spawn[i] = ENTITY_NO_SPAWN;
+	entities->count++;
+	return i;
+}
+
+// Replaces whatever entities there were with the ones the level starts with.
+void spawn_level_entities(entities_t* entities, const level_t* level) {
+	entities->count = 0;
+	for (int i = 0; i < level->entity_count; i++) {
+		const entity_spawn_t* spawn = &level->entities[i];
+		uint8_t flags = spawn->kind == ENTITY_HAZARD ? ENTITY_FLAG_COLLIDES : 0;
+		int entity = spawn_entity(entities, spawn->kind, spawn->position, spawn->velocity, flags);
+		if (entity != -1) {
+			entities->spawn[entity] = i;
+		}
+	}
+}
+
+void remove_dead_entities(entities_t* entities) {
+	int i = 0;
+	while (i < entities->count) {
+		if (!(entities->flags[i] & ENTITY_FLAG_DEAD)) {
+			i++;
+			continue;
+		}
+		int last = entities->count - 1;
+		entities->x[i] = entities->x[last];
+		entities->y[i] = entities->y[last];
+		entities->velocity_x[i] = entities->velocity_x[last];
+		entities->velocity_y[i] = entities->velocity_y[last];
+		entities->kind[i] = entities->kind[last];
+		entities->flags[i] = entities->flags[last];
+		entities->spawn[i] = entities->spawn[last];
+		entities->count--;
+	}
+}
+
+/**
+ * Moves every entity by its velocity. With walls, each one is swept through
+ * the wall grid and bounces off whatever it hits. Without walls (NULL) they
+ * move freely, which is what the benchmark's open world uses.
+ */
+void update_entities(entities_t* entities, const int walls[LEVEL_HEIGHT][LEVEL_WIDTH], float seconds) {
+	int count = entities->count;
+	float* x = entities->x;
+	float* y = entities->y;
+	float* velocity_x = entities->velocity_x;
+	float* velocity_y = entities->velocity_y;
+
+	if (!walls) {
+		for (int i = 0; i < count; i++) {
+			x[i] += velocity_x[i] * seconds;
+			y[i] += velocity_y[i] * seconds;
+		}
+		return;
+	}
+
+	for (int i = 0; i < count; i++) {
+		box_t box = {
+			.min = { .x = x[i] - ENTITY_HALF_SIZE, .y = y[i] - ENTITY_HALF_SIZE },
+			.max = { .x = x[i] + ENTITY_HALF_SIZE, .y = y[i] + ENTITY_HALF_SIZE },
+		};
+		vec2_t motion = { .x = velocity_x[i] * seconds, .y = velocity_y[i] * seconds };
+		sweep_t sweep = sweep_box(walls, box, motion);
+		x[i] += sweep.motion.x;
+		y[i] += sweep.motion.y;
+		if (sweep.hit_x) {
+			velocity_x[i] = -velocity_x[i];
+		}
+		if (sweep.hit_y) {
+			velocity_y[i] = -velocity_y[i];
+		}
+	}
+}
+
+// floorf() without the library call. Only valid in int range, which cell
+// coordinates always are.
+int cell_of(float coordinate) {
+	int cell = (int) coordinate;
+	return coordinate < cell ? cell - 1 : cell;
+}
+
+bool create_spatial_hash(spatial_hash_t* hash, int capacity) {
+	// About two buckets per entity keeps unrelated cells from sharing a
+	// bucket most of the time. Split them into a grid as square as possible.
+	int grid_width = 8;
+	int grid_height = 8;
+	while (grid_width * grid_height < capacity * 2) {
+		if (grid_width == grid_height) {
+			grid_width *= 2;
+		} else {
+			grid_height *= 2;
+		}
+	}
+
+	hash->grid_width = grid_width;
+	hash->grid_height = grid_height;
+	hash->bucket_count = grid_width * grid_height;
+	hash->capacity = capacity;
+	hash->bucket_start = malloc(sizeof(int) * (hash->bucket_count + 1));
+	hash->bucket_fill = malloc(sizeof(int) * hash->bucket_count);
+	hash->entity_bucket = malloc(sizeof(int) * capacity);
+	hash->entries = malloc(sizeof(int) * capacity);
+	hash->entry_x = malloc(sizeof(float) * capacity);
+	hash->entry_y = malloc(sizeof(float) * capacity);
+
+	if (
+		!hash->bucket_start || !hash->bucket_fill || !hash->entity_bucket
+		|| !hash->entries || !hash->entry_x || !hash->entry_y
+	) {
+		destroy_spatial_hash(hash);
+		return false;
+	}
+	return true;
+}
+
+void destroy_spatial_hash(spatial_hash_t* hash) {
+	free(hash->bucket_start);
+	free(hash->bucket_fill);
+	free(hash->entity_bucket);
+	free(hash->entries);
+	free(hash->entry_x);
+	free(hash->entry_y);
+	memset(hash, 0, sizeof(*hash));
+}
+
+int hash_cell(const spatial_hash_t* hash, int cell_x, int cell_y) {
+	return (cell_y & (hash->grid_height - 1)) * hash->grid_width + (cell_x & (hash->grid_width - 1));
+}
+
+void build_spatial_hash(spatial_hash_t* hash, const entities_t* entities) {
+	int count = entities->count < hash->capacity ? entities->count : hash->capacity;
+
+	memset(hash->bucket_start, 0, sizeof(int) * (hash->bucket_count + 1));
+	for (int i = 0; i < count; i++) {
+		int bucket = hash_cell(hash, cell_of(entities->x[i]), cell_of(entities->y[i]));
+		hash->entity_bucket[i] = bucket;
+		hash->bucket_start[bucket + 1]++;
+	}
+	for (int b = 0; b < hash->bucket_count; b++) {
+		hash->bucket_start[b + 1] += hash->bucket_start[b];
+	}
+
+	memcpy(hash->bucket_fill, hash->bucket_start, sizeof(int) * hash->bucket_count);
+	for (int i = 0; i < count; i++) {
+		int entry = hash->bucket_fill[hash->entity_bucket[i]]++;
+		hash->entries[entry] = i;
+		hash->entry_x[entry] = entities->x[i];
+		hash->entry_y[entry] = entities->y[i];
+	}
+}
+
+/**
+ * Finds the entities whose boxes overlap the area and writes up to
+ * max_results of their indexes into results. Returns how many it found.
+ *
+ * Cells a grid's width apart share a bucket, so an entity only counts when it
+ * is actually in the cell being looked at. Otherwise it could be found twice.
+ */
+int query_spatial_hash(const spatial_hash_t* hash, box_t area, int* results, int max_results) {
+	// Grow the area by an entity's size, then the entity's center just has
+	// to be inside it.
+	area.min.x -= ENTITY_HALF_SIZE;
+	area.min.y -= ENTITY_HALF_SIZE;
+	area.max.x += ENTITY_HALF_SIZE;
+	area.max.y += ENTITY_HALF_SIZE;
+
+	int found = 0;
+	int first_x = cell_of(area.min.x);
+	int first_y = cell_of(area.min.y);
+	int last_x = cell_of(area.max.x);
+	int last_y = cell_of(area.max.y);
+
+	for (int cell_y = first_y; cell_y <= last_y; cell_y++) {
+		for (int cell_x = first_x; cell_x <= last_x; cell_x++) {
+			int bucket = hash_cell(hash, cell_x, cell_y);
+			for (int e = hash->bucket_start[bucket]; e < hash->bucket_start[bucket + 1]; e++) {
+				float x = hash->entry_x[e];
+				float y = hash->entry_y[e];
+				if (cell_of(x) != cell_x || cell_of(y) != cell_y) {
+					continue;
+				}
+				if (x <= area.min.x || x >= area.max.x || y <= area.min.y || y >= area.max.y) {
+					continue;
+				}
+				if (found == max_results) {
+					return found;
+				}
+				results[found++] = hash->entries[e];
+			}
+		}
+	}
+	return found;
+}
+
+/**
+ * Checks the entity at entry against every entry in [first, last) and
+ * bounces it off the ones it overlaps. Returns how many bounced.
+ *
+ * Entries that share a bucket with a neighbor cell without being in it are
+ * at least a grid's width away, so the reach test throws them out too.
+ */
+int collide_with_entries(const spatial_hash_t* hash, entities_t* entities, int entry, int first, int last) {
+	int bounces = 0;
+	float reach = ENTITY_HALF_SIZE * 2;
+	int i = hash->entries[entry];
+	float x = hash->entry_x[entry];
+	float y = hash->entry_y[entry];
+
+	for (int e = first; e < last; e++) {
+		float offset_x = hash->entry_x[e] - x;
+		float offset_y = hash->entry_y[e] - y;
+		if (fabsf(offset_x) >= reach || fabsf(offset_y) >= reach) {
+			continue;
+		}
+		int j = hash->entries[e];
+		if (!(entities->flags[j] & ENTITY_FLAG_COLLIDES)) {
+			continue;
+		}
+
+		// Only bounce if they're moving toward each other, or two
+		// overlapping entities would keep swapping forever.
+		float relative_x = entities->velocity_x[j] - entities->velocity_x[i];
+		float relative_y = entities->velocity_y[j] - entities->velocity_y[i];
+		if (relative_x * offset_x + relative_y * offset_y >= 0) {
+			continue;
+		}
+
+		float swap_x = entities->velocity_x[i];
+		float swap_y = entities->velocity_y[i];
+		entities->velocity_x[i] = entities->velocity_x[j];
+		entities->velocity_y[i] = entities->velocity_y[j];
+		entities->velocity_x[j] = swap_x;
+		entities->velocity_y[j] = swap_y;
+		bounces++;
+	}
+	return bounces;
+}
+
+/**
+ * Entities with ENTITY_FLAG_COLLIDES that overlap swap velocities, which is
+ * an elastic bounce between equal masses. The hash has to be built from the
+ * current positions.
+ *
+ * Entities are smaller than a cell, so anything touching one is in one of
+ * the nine cells around it. Each entity only looks at the later entries in
+ * its own cell, the cell to its right and the three cells below, and every
+ * pair is still found exactly once: whichever of the two comes first finds
+ * the other.
+ *
+ * Buckets are laid out in rows, so those cells are two runs of consecutive
+ * entries rather than five separate buckets. Entities are visited in bucket
+ * order, so neighbors are usually still in cache from the last one.
+ *
+ * Returns how many pairs bounced.
+ */
+int collide_entities(const spatial_hash_t* hash, entities_t* entities) {
+	int bounces = 0;
+	int entry_count = hash->bucket_start[hash->bucket_count];
+	int last_column = hash->grid_width - 1;
+
+	for (int entry = 0; entry < entry_count; entry++) {
+		if (!(entities->flags[hash->entries[entry]] & ENTITY_FLAG_COLLIDES)) {
+			continue;
+		}
+		int cell_x = cell_of(hash->entry_x[entry]);
+		int cell_y = cell_of(hash->entry_y[entry]);
+		int column = cell_x & last_column;
+		int below = hash_cell(hash, cell_x, cell_y + 1);
+
+		if (column > 0 && column < last_column) {
+			int right = hash_cell(hash, cell_x + 1, cell_y);
+			bounces += collide_with_entries(hash, entities, entry, entry + 1, hash->bucket_start[right + 1]);
+			bounces += collide_with_entries(hash, entities, entry, hash->bucket_start[below - 1], hash->bucket_start[below + 2]);
+			continue;
+		}
+
+		// At the edge of the grid the cells to the left and right wrap around
+		// to the other end of the row, so they aren't next to each other.
+		int own = hash_cell(hash, cell_x, cell_y);
+		bounces += collide_with_entries(hash, entities, entry, entry + 1, hash->bucket_start[own + 1]);
+		int neighbors[4] = {
+			hash_cell(hash, cell_x + 1, cell_y),
+			hash_cell(hash, cell_x - 1, cell_y + 1),
+			below,
+			hash_cell(hash, cell_x + 1, cell_y + 1),
+		};
+		for (int n = 0; n < 4; n++) {
+			bounces += collide_with_entries(hash, entities, entry, hash->bucket_start[neighbors[n]], hash->bucket_start[neighbors[n] + 1]);
+		}
+	}
+	return bounces;
+}
@@ -0,0 +1,82 @@
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "collision.h"
+#include "level.h"
+#include "vector.h"
+
+// Half the width of every entity's box, in cells.
+#define ENTITY_HALF_SIZE 0.2f
+
+// Bounces off other entities that have this flag too.
+#define ENTITY_FLAG_COLLIDES 0x01
+// Removed at the end of the tick.
+#define ENTITY_FLAG_DEAD 0x02
+
+// Spawn index of entities that didn't come from the level's list.
+#define ENTITY_NO_SPAWN 0xFF
+
+/**
+ * Every entity in the level, stored as one array per component. The update
+ * and draw passes walk each array front to back, so they only pull in the
+ * components they use. Entities are removed by moving the last one into the
+ * gap, so the arrays never have holes.
+ */
+typedef struct {
+	int count;
+	int capacity;
+	float* x;
+	float* y;
+	float* velocity_x;
+	float* velocity_y;
+	uint8_t* kind;
+	uint8_t* flags;
+	// Which of the level's entities this one was spawned from.
+	uint8_t* spawn;
+} entities_t;
+
+/**
+ * Uniform grid of one-cell buckets that wraps around, so the world doesn't
+ * need bounds: cell (x, y) goes in bucket (x mod width, y mod height). Cells
+ * next to each other have buckets next to each other, which keeps neighbor
+ * lookups in cache.
+ *
+ * It's rebuilt from scratch every tick with a counting sort: count entities
+ * per bucket, turn the counts into offsets, then drop each entity into place.
+ * Positions are copied along with the entity index so walking a bucket reads
+ * memory in order. No allocation after creation.
+ */
+typedef struct {
+	// Both powers of two.
+	int grid_width;
+	int grid_height;
+	int bucket_count;
+	// Where each bucket's entities start in the entries. One longer than
+	// bucket_count so bucket b ends where b + 1 starts.
+	int* bucket_start;
+	int* bucket_fill;
+	// Bucket of each entity, by entity index.
+	int* entity_bucket;
+	// Entity index and position of every entry, sorted by bucket.
+	int* entries;
+	float* entry_x;
+	float* entry_y;
+	int capacity;
+} spatial_hash_t;
+
+bool create_entities(entities_t* entities, int capacity);
+void destroy_entities(entities_t* entities);
+int spawn_entity(entities_t* entities, entity_kind_t kind, vec2_t position, vec2_t velocity, uint8_t flags);
+void spawn_level_entities(entities_t* entities, const level_t* level);
+void remove_dead_entities(entities_t* entities);
+void update_entities(entities_t* entities, const int walls[LEVEL_HEIGHT][LEVEL_WIDTH], float seconds);
+
+bool create_spatial_hash(spatial_hash_t* hash, int capacity);
+void destroy_spatial_hash(spatial_hash_t* hash);
+void build_spatial_hash(spatial_hash_t* hash, const entities_t* entities);
+int query_spatial_hash(const spatial_hash_t* hash, box_t area, int* results, int max_results);
+int collide_entities(const spatial_hash_t* hash, entities_t* entities);
+
+#endif
@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <ctype.h>
+#include "hud.h"
+#include "display.h"
+#include "palette.h"
+#include "sprites.h"
+#include "timing.h"
+
+bool hud_visible = false;
+
+#define GLYPH_COLUMNS 5
+#define GLYPH_ROWS 7
+// Each font pixel is drawn as a square this many screen pixels wide.
+#define GLYPH_SCALE 2
+#define GLYPH_ADVANCE ((GLYPH_COLUMNS + 1) * GLYPH_SCALE)
+#define LINE_HEIGHT ((GLYPH_ROWS + 2) * GLYPH_SCALE)
+// Five columns can have at most three separate runs of set pixels.
+#define MAX_SPANS_PER_ROW 3
+
+/**
+ * 5x7 font, one byte per row with the leftmost column in bit 4. Only the
+ * characters the HUD needs are here, everything else draws as a blank.
+ */
+const uint8_t font_rows[128][GLYPH_ROWS] = {
+	['0'] = { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },
+	['1'] = { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },
+	['2'] = { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },
+	['3'] = { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },
+	['4'] = { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },
+	['5'] = { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },
+	['6'] = { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },
+	['7'] = { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },
+	['8'] = { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },
+	['9'] = { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },
+	['A'] = { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 },
+	['B'] = { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },
+	['C'] = { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },
+	['D'] = { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },
+	['E'] = { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },
+	['F'] = { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },
+	['G'] = { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },
+	['H'] = { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },
+	['I'] = { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },
+	['J'] = { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },
+	['K'] = { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },
+	['L'] = { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },
+	['M'] = { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },
+	['N'] = { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },
+	['O'] = { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },
+	['P'] = { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },
+	['Q'] = { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },
+	['R'] = { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },
+	['S'] = { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },
+	['T'] = { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },
+	['U'] = { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },
+	['V'] = { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },
+	['W'] = { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },
+	['X'] = { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },
+	['Y'] = { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 },
+	['Z'] = { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F },
+	['.'] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C },
+	[':'] = { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },
+	['-'] = { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 },
+	['/'] = { 0x01, 0x01, 0x02, 0x04, 0x08, 0x10, 0x10 },
+	['%'] = { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },
+};
+
+typedef struct {
+	uint8_t start;
+	uint8_t length;
+} glyph_span_t;
+
+// A glyph turned into runs of screen pixels, already scaled. Drawing a row is
+// then just a fill per run instead of a test per font pixel.
+typedef struct {
+	uint8_t span_count[GLYPH_ROWS];
+	glyph_span_t spans[GLYPH_ROWS][MAX_SPANS_PER_ROW];
+} glyph_t;
+
+glyph_t glyphs[128];
+bool glyphs_built = false;
+
+void build_glyphs(void) {
+	for (int c = 0; c < 128; c++) {
+		for (int row = 0; row < GLYPH_ROWS; row++) {
+			uint8_t bits = font_rows[c][row];
+			int count = 0;
+			int col = 0;
+			while (col < GLYPH_COLUMNS) {
+				if (!(bits & (0x10 >> col))) {
+					col++;
+					continue;
+				}
+				int start = col;
+				while (col < GLYPH_COLUMNS && (bits & (0x10 >> col))) {
+					col++;
+				}
+				glyphs[c].spans[row][count].start = start * GLYPH_SCALE;
+				glyphs[c].spans[row][count].length = (col - start) * GLYPH_SCALE;
+				count++;
+			}
+			glyphs[c].span_count[row] = count;
+		}
+	}
+	glyphs_built = true;
+}
+
+// The sprite renderer's copy of the font: every printable character drawn in
+// white, GLYPHS_PER_ROW to a row. Text is tinted with color modulation.
+#define GLYPHS_PER_ROW 32
+#define FIRST_ATLAS_GLYPH ' '
+#define ATLAS_GLYPH_COUNT (128 - FIRST_ATLAS_GLYPH)
+SDL_Texture* glyph_atlas = NULL;
+
+// Draws the atlas with draw_text() into color_buffer, which must be clear,
+// and uploads it.
+bool bake_glyph_atlas(void) {
+	int rows = (ATLAS_GLYPH_COUNT + GLYPHS_PER_ROW - 1) / GLYPHS_PER_ROW;
+	char text[GLYPHS_PER_ROW + 1];
+	for (int row = 0; row < rows; row++) {
+		int count = 0;
+		for (int i = 0; i < GLYPHS_PER_ROW; i++) {
+			int c = FIRST_ATLAS_GLYPH + row * GLYPHS_PER_ROW + i;
+			// A character that isn't drawable stands in for the ones past
+			// the end, since draw_text() stops at the first 0.
+			text[count++] = c < 128 ? (char) c : ' ';
+		}
+		text[count] = '\0';
+		draw_text(0, row * GLYPH_ROWS * GLYPH_SCALE, text, 0xFFFFFFFF);
+	}
+	glyph_atlas = bake_texture(color_buffer, 0, 0, GLYPHS_PER_ROW * GLYPH_ADVANCE, rows * GLYPH_ROWS * GLYPH_SCALE);
+	return glyph_atlas != NULL;
+}
+
+void destroy_glyph_atlas(void) {
+	if (glyph_atlas) {
+		SDL_DestroyTexture(glyph_atlas);
+		glyph_atlas = NULL;
+	}
+}
+
+void draw_atlas_text(int x, int y, const char* text, uint32_t color) {
+	SDL_SetTextureColorMod(glyph_atlas, (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
+	for (const char* c = text; *c != '\0'; c++) {
+		int glyph = (toupper((unsigned char) *c) & 0x7F) - FIRST_ATLAS_GLYPH;
+		if (glyph > 0) {
+			SDL_Rect source = {
+				.x = (glyph % GLYPHS_PER_ROW) * GLYPH_ADVANCE,
+				.y = (glyph / GLYPHS_PER_ROW) * GLYPH_ROWS * GLYPH_SCALE,
+				.w = GLYPH_ADVANCE,
+				.h = GLYPH_ROWS * GLYPH_SCALE,
+			};
+			SDL_Rect destination = { .x = x, .y = y, .w = source.w, .h = source.h };
+			SDL_RenderCopy(renderer, glyph_atlas, &source, &destination);
+		}
+		x += GLYPH_ADVANCE;
+	}
+}
+
+void draw_text(int x, int y, const char* text, uint32_t color) {
+	if (!glyphs_built) {
+		build_glyphs();
+	}
+	if (x < 0 || y < 0 || y + GLYPH_ROWS * GLYPH_SCALE > window_height) {
+		return;
+	}
+	if (sprites_active) {
+		draw_atlas_text(x, y, text, color);
+		return;
+	}
+
+	mark_rows_drawn(y, y + GLYPH_ROWS * GLYPH_SCALE - 1);
+	uint8_t index = index_buffer ? palette_index(color) : 0;
+
+	for (const char* c = text; *c != '\0'; c++) {
+		if (x + GLYPH_ADVANCE > window_width) {
+			return;
+		}
+		const glyph_t* glyph = &glyphs[toupper((unsigned char) *c) & 0x7F];
+
+		for (int screen_row = 0; screen_row < GLYPH_ROWS * GLYPH_SCALE; screen_row++) {
+			int row = screen_row / GLYPH_SCALE;
+			int offset = (y + screen_row) * window_width + x;
+			if (index_buffer) {
+				for (int span = 0; span < glyph->span_count[row]; span++) {
+					memset(&index_buffer[offset + glyph->spans[row][span].start], index, glyph->spans[row][span].length);
+				}
+				continue;
+			}
+			uint32_t* line = &color_buffer[offset];
+			for (int span = 0; span < glyph->span_count[row]; span++) {
+				uint32_t* pixel = line + glyph->spans[row][span].start;
+				uint32_t* end = pixel + glyph->spans[row][span].length;
+				while (pixel < end) {
+					*pixel++ = color;
+				}
+			}
+		}
+		x += GLYPH_ADVANCE;
+	}
+}
+
+// Each bar is this wide, with one pixel of it left as a gap.
+#define GRAPH_BAR_WIDTH 3
+// The budget line is a dot on every other pixel along the graph.
+#define GRAPH_BUDGET_DOTS ((FRAME_HISTORY * GRAPH_BAR_WIDTH + 1) / 2)
+
+/**
+ * Works out the graph's bars and its budget line as rects. Bars within the
+ * budget go in bars. Bars over it go in over_budget, followed by the budget
+ * line's dots, which are the same color. That way each color is one batch,
+ * and the dots still end up on top.
+ */
+void frame_time_graph_rects(
+	int x, int y, int height,
+	SDL_Rect bars[FRAME_HISTORY], int* bar_count,
+	SDL_Rect over_budget[FRAME_HISTORY + GRAPH_BUDGET_DOTS], int* over_budget_count
+) {
+	double budget_ms = 1000.0 / 60.0;
+	double graph_max_ms = budget_ms * 2;
+	*bar_count = 0;
+	*over_budget_count = 0;
+
+	int oldest = (frame_history_next - frame_history_count + FRAME_HISTORY) % FRAME_HISTORY;
+	for (int i = 0; i < frame_history_count; i++) {
+		double frame_ms = frame_history[(oldest + i) % FRAME_HISTORY].frame_ms;
+		int bar_height = (int) (frame_ms / graph_max_ms * height);
+		if (bar_height > height) {
+			bar_height = height;
+		}
+		SDL_Rect bar = { .x = x + i * GRAPH_BAR_WIDTH, .y = y + height - bar_height, .w = GRAPH_BAR_WIDTH - 1, .h = bar_height };
+		if (frame_ms > budget_ms) {
+			over_budget[(*over_budget_count)++] = bar;
+		} else {
+			bars[(*bar_count)++] = bar;
+		}
+	}
+	for (int i = 0; i < FRAME_HISTORY * GRAPH_BAR_WIDTH; i += 2) {
+		SDL_Rect dot = { .x = x + i, .y = y + height / 2, .w = 1, .h = 1 };
+		over_budget[(*over_budget_count)++] = dot;
+	}
+}
+
+/**
+ * Bars for the last FRAME_HISTORY frame times, oldest on the left. The graph
+ * tops out at two 60Hz frames and the dotted line marks one. The sprite
+ * renderer gets the rects in one batch per color rather than a couple of
+ * hundred separate fills.
+ */
+void draw_frame_time_graph(int x, int y, int height, uint32_t color, uint32_t over_budget_color) {
+	if (x + FRAME_HISTORY * GRAPH_BAR_WIDTH > window_width || y + height > window_height) {
+		return;
+	}
+
+	SDL_Rect bars[FRAME_HISTORY];
+	SDL_Rect over_budget[FRAME_HISTORY + GRAPH_BUDGET_DOTS];
+	int bar_count;
+	int over_budget_count;
+	frame_time_graph_rects(x, y, height, bars, &bar_count, over_budget, &over_budget_count);
+
+	if (sprites_active) {
+		fill_sprite_rects(bars, bar_count, color);
+		fill_sprite_rects(over_budget, over_budget_count, over_budget_color);
+		return;
+	}
+	for (int i = 0; i < bar_count; i++) {
+		draw_rect(bars[i].x, bars[i].y, bars[i].w, bars[i].h, color);
+	}
+	for (int i = 0; i < over_budget_count; i++) {
+		draw_rect(over_budget[i].x, over_budget[i].y, over_budget[i].w, over_budget[i].h, over_budget_color);
+	}
+	mark_rows_drawn(y, y + height - 1);
+}
+
+void draw_performance_hud(void) {
+	if (!hud_visible || frame_history_count == 0) {
+		return;
+	}
+
+	const char* phase_names[PHASE_COUNT] = {
+		[PHASE_INPUT] = "INPUT",
+		[PHASE_UPDATE] = "UPDATE",
+		[PHASE_DRAW] = "DRAW",
+		[PHASE_HUD] = "HUD",
+		[PHASE_COMPOSITE] = "BLEND",
+		[PHASE_UPLOAD] = "UPLOAD",
+		[PHASE_PRESENT] = "PRESENT",
+	};
+
+	// Average over the whole history so the numbers are steady enough to read.
+	double frame_ms = 0;
+	double phase_ms[PHASE_COUNT] = { 0 };
+	for (int i = 0; i < frame_history_count; i++) {
+		frame_ms += frame_history[i].frame_ms;
+		for (int phase = 0; phase < PHASE_COUNT; phase++) {
+			phase_ms[phase] += frame_history[i].phase_ms[phase];
+		}
+	}
+	frame_ms /= frame_history_count;
+	int last = (frame_history_next - 1 + FRAME_HISTORY) % FRAME_HISTORY;
+
+	uint32_t text_color = 0xFFCCCCCC;
+	uint32_t warning_color = 0xFFFF0000;
+	int x = 420;
+	int y = 10;
+	char line[64];
+
+	snprintf(line, sizeof(line), "FPS %.1f", frame_ms > 0 ? 1000.0 / frame_ms : 0.0);
+	draw_text(x, y, line, text_color);
+	y += LINE_HEIGHT;
+
+	snprintf(line, sizeof(line), "FRAME %.2fMS", frame_ms);
+	draw_text(x, y, line, text_color);
+	y += LINE_HEIGHT;
+
+	draw_frame_time_graph(x, y, 60, 0xFF555555, warning_color);
+	y += 60 + GLYPH_SCALE * 2;
+
+	for (int phase = 0; phase < PHASE_COUNT; phase++) {
+		snprintf(line, sizeof(line), "%-8s%.3fMS", phase_names[phase], phase_ms[phase] / frame_history_count);
+		draw_text(x, y, line, text_color);
+		y += LINE_HEIGHT;
+	}
+
+	snprintf(line, sizeof(line), "PIXELS  %d", frame_history[last].pixels_uploaded);
+	draw_text(x, y, line, text_color);
+}
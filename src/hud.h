@@ -0,0 +1,14 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+extern bool hud_visible;
+
+bool bake_glyph_atlas(void);
+void destroy_glyph_atlas(void);
+void draw_text(int x, int y, const char* text, uint32_t color);
+void draw_performance_hud(void);
+
+#endif
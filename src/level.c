@@ -393,10 +393,12 @@ const level_t levels[13] = {
 level_state_t create_level_state(level_t level) {
 	level_state_t level_state = {
 		.player = level.start,
+		.player_velocity = { .x = 0, .y = 0 },
 		.player_moved = false,
 		.flashlight_charges = level.flashlight_charges,
 		.flashlight_on = false,
 		.player_collided = false,
+		.collected_pickups = 0,
 	};
 	return level_state;
 }
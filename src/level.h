@@ -2,21 +2,52 @@
 #define LEVEL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "vector.h"
 
+#define LEVEL_WIDTH 20
+#define LEVEL_HEIGHT 20
+
+// Most entities a level can start with.
+#define MAX_LEVEL_ENTITIES 16
+
+typedef enum {
+	// Kills the player on touch.
+	ENTITY_HAZARD,
+	// Gives back a used flashlight charge.
+	ENTITY_PICKUP,
+} entity_kind_t;
+
+typedef struct {
+	entity_kind_t kind;
+	// Where the entity's center starts. Unlike the player's position this
+	// isn't a cell's top left corner, so the middle of cell (3, 4) is
+	// (3.5, 4.5).
+	vec2_t position;
+	// Cells per second.
+	vec2_t velocity;
+} entity_spawn_t;
+
 typedef struct {
-	int walls [20][20];
+	int walls [LEVEL_HEIGHT][LEVEL_WIDTH];
 	vec2_t start;
 	vec2_t finish;
 	int flashlight_charges;
+	entity_spawn_t entities[MAX_LEVEL_ENTITIES];
+	int entity_count;
 } level_t;
 
 typedef struct {
 	vec2_t player;
+	// Cells per second.
+	vec2_t player_velocity;
 	bool player_moved;
 	int flashlight_charges;
 	bool flashlight_on;
 	bool player_collided;
+	// One bit per entry in the level's entities, set once that pickup has
+	// been collected.
+	uint16_t collected_pickups;
 } level_state_t;
 
 extern const level_t levels[13];
@@ -2,35 +2,255 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <SDL2/SDL.h>
-#include <time.h>
+#include "benchmark.h"
+#include "collision.h"
+#include "compositor.h"
+#include "config.h"
 #include "display.h"
+#include "entity.h"
+#include "hud.h"
+#include "palette.h"
+#include "prefetch.h"
+#include "rewind.h"
+#include "sprites.h"
+#include "timing.h"
 #include "vector.h"
 
 bool is_running = false;
 level_state_t level_state;
 int level_index = 0;
-clock_t clock_time_at_player_collision = 0;
+// Ticks since the current level started.
+uint32_t level_ticks = 0;
+// When the player hit something.
+uint64_t time_at_player_collision = 0;
+// Which level's walls are drawn on the walls layer right now. They only
+// change with the level, so the layer is kept between frames.
+int walls_layer_level = -1;
+bool walls_were_lit = true;
+uint64_t time_at_walls_dark = 0;
+// The walls have gone dark but haven't finished fading out yet.
+bool walls_fading = false;
+// Something that's drawn changed since the last frame.
+bool screen_changed = true;
 
-float seconds_since_clock_time(clock_t clock_time) {
-	return (float) (clock()-clock_time) / CLOCKS_PER_SEC;
+// The game state advances in fixed steps, so movement and collisions come out
+// the same at any frame rate.
+#define TICKS_PER_SECOND 60
+#define TICK_SECONDS (1.0f / TICKS_PER_SECOND)
+// After a long stall, don't try to catch up on more than this many ticks in
+// one frame.
+#define MAX_TICKS_PER_FRAME 5
+// Cells per second.
+#define PLAYER_SPEED 5.0f
+// Half the width of the player's collision box, in cells. The box is centered
+// on the player's cell.
+#define PLAYER_HALF_SIZE 0.25f
+
+// Most entities that can be alive at once during play.
+#define MAX_ENTITIES 1024
+
+entities_t entities;
+spatial_hash_t entity_hash;
+
+// How far back the game goes after a collision, on top of the collision
+// itself.
+#define REWIND_SECONDS_BEFORE_COLLISION 1
+rewind_buffer_t history;
+// Backspace is held, so ticks go backwards instead of forwards.
+bool rewind_held = false;
+
+// Palette mode keeps the grid and walls in an index buffer of their own. Each
+// frame they're copied back under whatever was drawn over them the frame
+// before.
+uint8_t* index_frame = NULL;
+uint8_t* index_background = NULL;
+int index_background_level = -1;
+
+// Which way the movement keys are pushing the player, each axis -1 to 1.
+vec2_t movement_input = { .x = 0, .y = 0 };
+uint64_t previous_frame_time = 0;
+double unsimulated_seconds = 0;
+
+// With nothing happening, wake up this often anyway to look around.
+#define IDLE_TIMEOUT_MS 1000
+
+// How long the walls take to fade out after they stop being lit.
+#define WALL_FADE_SECONDS 0.6f
+// How long the screen flashes red after the player hits a wall.
+#define COLLISION_FLASH_SECONDS 0.4f
+
+// Wall clock time, unlike clock(). The process barely uses any CPU while it
+// waits on vsync, so CPU time would stretch the fades out.
+float seconds_since(uint64_t time) {
+	return (float) (timing_ms_between(time, timing_now()) / 1000);
 }
 
-void setup(void) {
-	color_buffer = malloc(sizeof(uint32_t) * (window_width * window_height));
-	color_buffer_texture = SDL_CreateTexture(
-		renderer,
-		SDL_PIXELFORMAT_ARGB8888,
-		SDL_TEXTUREACCESS_STREAMING,
-		window_width,
-		window_height
-	);
+void start_level(int index) {
+	level_index = index;
+	level_ticks = 0;
 	level_state = create_level_state(levels[level_index]);
+	spawn_level_entities(&entities, &levels[level_index]);
 }
 
-void process_input(void) {
-	SDL_Event event;
-	SDL_PollEvent(&event);
+int next_level_index(int index) {
+	int next_level = index + 1;
+	if (next_level == sizeof(levels) / sizeof(levels[0])) {
+		next_level = 0;
+	}
+	return next_level;
+}
+
+// Moves on to the given level. The prefetch worker has usually built it
+// already, in which case this is a few copies and a buffer swap instead of
+// drawing the walls on the next frame.
+void advance_to_level(int index) {
+	prepared_level_t* prepared = take_prefetched_level(index);
+	if (prepared) {
+		level_index = index;
+		level_ticks = 0;
+		level_state = prepared->level_state;
+		spawn_level_entities(&entities, &levels[level_index]);
+		swap_layer_pixels(LAYER_WALLS, &prepared->walls, &prepared->walls_drawn_top, &prepared->walls_drawn_bottom);
+		walls_layer_level = level_index;
+	} else {
+		start_level(index);
+	}
+	prefetch_level(next_level_index(level_index));
+}
+
+snapshot_t take_snapshot(void) {
+	snapshot_t snapshot = {
+		.level_index = level_index,
+		.level_ticks = level_ticks,
+		.level_state = level_state,
+	};
+	return snapshot;
+}
+
+// Moves the entities forward one tick. They don't depend on the player, so
+// this is all it takes to replay them from a keyframe.
+void update_level_entities(const level_t* level) {
+	update_entities(&entities, level->walls, TICK_SECONDS);
+	build_spatial_hash(&entity_hash, &entities);
+	collide_entities(&entity_hash, &entities);
+}
+
+// Call it with the history's newest tick. The entities come back from that
+// tick's keyframe and are played forward the few ticks since.
+void restore_snapshot(const snapshot_t* snapshot) {
+	if (snapshot->level_index != level_index) {
+		prefetch_level(next_level_index(snapshot->level_index));
+	}
+	level_index = snapshot->level_index;
+	level_ticks = snapshot->level_ticks;
+	level_state = snapshot->level_state;
+
+	const level_t* level = &levels[level_index];
+	uint32_t keyframe_ticks = rewind_restore_entities(&history, &entities);
+	if (entities.count == 0) {
+		return;
+	}
+	for (uint32_t tick = keyframe_ticks; tick < level_ticks; tick++) {
+		update_level_entities(level);
+		remove_dead_entities(&entities);
+	}
+}
+
+void rewind_one_tick(void) {
+	snapshot_t snapshot;
+	if (rewind_step_back(&history, &snapshot)) {
+		restore_snapshot(&snapshot);
+		screen_changed = true;
+	}
+}
+
+// Goes back to a moment before the player collided. If the history doesn't
+// reach that far, the level starts over.
+void rewind_past_collision(void) {
+	screen_changed = true;
+	snapshot_t snapshot = take_snapshot();
+	while (snapshot.level_state.player_collided) {
+		if (!rewind_step_back(&history, &snapshot)) {
+			start_level(level_index);
+			rewind_reset(&history);
+			snapshot = take_snapshot();
+			rewind_record(&history, &snapshot, &entities);
+			return;
+		}
+	}
+	for (int tick = 0; tick < REWIND_SECONDS_BEFORE_COLLISION * TICKS_PER_SECOND; tick++) {
+		if (!rewind_step_back(&history, &snapshot)) {
+			break;
+		}
+	}
+	restore_snapshot(&snapshot);
+}
+
+// Only the default software path draws into the compositor's layers.
+bool using_layers(void) {
+	return config.renderer == RENDERER_SOFTWARE && !config.palette_mode;
+}
+
+bool create_frame_buffers(void) {
+	if (config.renderer == RENDERER_SPRITES) {
+		return true;
+	}
+	if (config.palette_mode) {
+		index_frame = malloc(window_width * window_height);
+		index_background = malloc(window_width * window_height);
+		return index_frame && index_background;
+	}
+	frame_buffer = malloc(sizeof(uint32_t) * (window_width * window_height));
+	return frame_buffer && create_layers();
+}
 
+void setup(void) {
+	if (!create_frame_buffers()) {
+		fprintf(stderr, "Error allocating frame buffers.\n");
+		is_running = false;
+		return;
+	}
+	if (!create_entities(&entities, MAX_ENTITIES) || !create_spatial_hash(&entity_hash, MAX_ENTITIES)) {
+		fprintf(stderr, "Error allocating entities.\n");
+		is_running = false;
+		return;
+	}
+	startup_stage_done("buffers");
+	if (config.renderer == RENDERER_SPRITES) {
+		if (!create_sprites()) {
+			fprintf(stderr, "Error baking sprites.\n");
+			is_running = false;
+			return;
+		}
+		startup_stage_done("sprites");
+	} else {
+		color_buffer_texture = SDL_CreateTexture(
+			renderer,
+			SDL_PIXELFORMAT_ARGB8888,
+			SDL_TEXTUREACCESS_STREAMING,
+			window_width,
+			window_height
+		);
+		startup_stage_done("texture");
+	}
+	// The prefetch worker has been building the first level since before the
+	// window opened, so this is usually just the buffer swap.
+	advance_to_level(level_index);
+	rewind_reset(&history);
+	snapshot_t snapshot = take_snapshot();
+	rewind_record(&history, &snapshot, &entities);
+
+	// Draw a grid on screen for debugging shape sizes. It never changes, so
+	// it's drawn into the background once instead of every frame.
+	if (using_layers()) {
+		select_layer(LAYER_BACKGROUND);
+		clear_color_buffer(0xFF000000);
+		draw_grid();
+	}
+	startup_stage_done("first level");
+}
+
+void handle_event(SDL_Event event) {
 	switch (event.type) {
 		case SDL_QUIT:
 			is_running = false;
@@ -39,29 +259,9 @@ void process_input(void) {
 			if (event.key.keysym.sym == SDLK_ESCAPE) {
 				is_running = false;
 			}
-			if ((event.key.keysym.scancode == SDL_SCANCODE_UP || event.key.keysym.scancode == SDL_SCANCODE_W) && !level_state.player_collided) {
-				level_state.player.y--;
-				if (level_state.flashlight_on) {
-					level_state.flashlight_on = false;
-				}
-			}
-			if ((event.key.keysym.scancode == SDL_SCANCODE_DOWN || event.key.keysym.scancode == SDL_SCANCODE_S) && !level_state.player_collided) {
-				level_state.player.y++;
-				if (level_state.flashlight_on) {
-					level_state.flashlight_on = false;
-				}
-			}
-			if ((event.key.keysym.scancode == SDL_SCANCODE_LEFT || event.key.keysym.scancode == SDL_SCANCODE_A) && !level_state.player_collided) {
-				level_state.player.x--;
-				if (level_state.flashlight_on) {
-					level_state.flashlight_on = false;
-				}
-			}
-			if ((event.key.keysym.scancode == SDL_SCANCODE_RIGHT || event.key.keysym.scancode == SDL_SCANCODE_D) && !level_state.player_collided) {
-				level_state.player.x++;
-				if (level_state.flashlight_on) {
-					level_state.flashlight_on = false;
-				}
+			if (event.key.keysym.scancode == SDL_SCANCODE_F1) {
+				hud_visible = !hud_visible;
+				screen_changed = true;
 			}
 			if (
 				event.key.keysym.scancode == SDL_SCANCODE_SPACE
@@ -71,39 +271,290 @@ void process_input(void) {
 			) {
 				level_state.flashlight_on = true;
 				level_state.flashlight_charges--;
+				screen_changed = true;
+			}
+			break;
+		case SDL_WINDOWEVENT:
+			// What was on screen may be gone, so it has to be drawn again.
+			// Anything else, like the mouse moving over the window, leaves
+			// it alone. Held keys are picked up by screen_may_change().
+			if (
+				event.window.event == SDL_WINDOWEVENT_EXPOSED
+				|| event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED
+				|| event.window.event == SDL_WINDOWEVENT_RESTORED
+			) {
+				screen_changed = true;
 			}
 			break;
 	}
 }
 
+// Drain every pending event each frame. Only handling one event per frame
+// lets a burst of key presses queue up and play out over several frames.
+void process_input(void) {
+	SDL_Event event;
+	while (SDL_PollEvent(&event)) {
+		if (event.type == SDL_KEYDOWN) {
+			latency_input_arrived(&event);
+		}
+		handle_event(event);
+	}
+
+	// Movement follows whichever keys are held down right now.
+	const uint8_t* keys = SDL_GetKeyboardState(NULL);
+	movement_input.x = 0;
+	movement_input.y = 0;
+	if (keys[SDL_SCANCODE_UP] || keys[SDL_SCANCODE_W]) movement_input.y -= 1;
+	if (keys[SDL_SCANCODE_DOWN] || keys[SDL_SCANCODE_S]) movement_input.y += 1;
+	if (keys[SDL_SCANCODE_LEFT] || keys[SDL_SCANCODE_A]) movement_input.x -= 1;
+	if (keys[SDL_SCANCODE_RIGHT] || keys[SDL_SCANCODE_D]) movement_input.x += 1;
+	rewind_held = keys[SDL_SCANCODE_BACKSPACE];
+}
+
+box_t player_box(void) {
+	box_t box = {
+		.min = {
+			.x = level_state.player.x + 0.5f - PLAYER_HALF_SIZE,
+			.y = level_state.player.y + 0.5f - PLAYER_HALF_SIZE,
+		},
+		.max = {
+			.x = level_state.player.x + 0.5f + PLAYER_HALF_SIZE,
+			.y = level_state.player.y + 0.5f + PLAYER_HALF_SIZE,
+		},
+	};
+	return box;
+}
+
+void player_collided(void) {
+	if (!level_state.player_collided) {
+		level_state.player_collided = true;
+		level_state.player_velocity.x = 0;
+		level_state.player_velocity.y = 0;
+		time_at_player_collision = timing_now();
+	}
+}
+
+void move_player(const level_t* level) {
+	vec2_t velocity = movement_input;
+	// Don't go faster diagonally. Both axes get scaled by 1/sqrt(2).
+	if (velocity.x != 0 && velocity.y != 0) {
+		velocity.x *= 0.70710678f;
+		velocity.y *= 0.70710678f;
+	}
+	velocity.x *= PLAYER_SPEED;
+	velocity.y *= PLAYER_SPEED;
+	level_state.player_velocity = velocity;
+
+	if (velocity.x == 0 && velocity.y == 0) {
+		return;
+	}
+	if (level_state.flashlight_on) {
+		level_state.flashlight_on = false;
+	}
+
+	vec2_t motion = { .x = velocity.x * TICK_SECONDS, .y = velocity.y * TICK_SECONDS };
+	sweep_t sweep = sweep_box(level->walls, player_box(), motion);
+
+	level_state.player.x += sweep.motion.x;
+	level_state.player.y += sweep.motion.y;
+
+	if (sweep.hit_x || sweep.hit_y) {
+		player_collided();
+	}
+}
+
+// Hazards the player touches end the run, and pickups give back a used
+// flashlight charge.
+void touch_entities(const level_t* level) {
+	int touching[16];
+	int count = query_spatial_hash(&entity_hash, player_box(), touching, 16);
+	for (int t = 0; t < count; t++) {
+		int i = touching[t];
+		if (entities.kind[i] == ENTITY_HAZARD) {
+			player_collided();
+		} else if (entities.kind[i] == ENTITY_PICKUP && level_state.flashlight_charges < level->flashlight_charges) {
+			level_state.flashlight_charges++;
+			entities.flags[i] |= ENTITY_FLAG_DEAD;
+			if (entities.spawn[i] != ENTITY_NO_SPAWN) {
+				level_state.collected_pickups |= 1 << entities.spawn[i];
+			}
+		}
+	}
+}
+
 void update(void) {
+	if (level_state.player_collided && seconds_since(time_at_player_collision) > 2) {
+		rewind_past_collision();
+		return;
+	}
+
 	level_t level = levels[level_index];
+	level_ticks++;
+
+	if (!level_state.player_collided) {
+		move_player(&level);
+	}
+
+	update_level_entities(&level);
+	if (!level_state.player_collided) {
+		touch_entities(&level);
+	}
+	remove_dead_entities(&entities);
 
 	if ((level_state.player.x != level.start.x || level_state.player.y != level.start.y) && !level_state.player_moved) {
 		level_state.player_moved = true;
 	}
 
-	bool wallCollision = level.walls[(int)level_state.player.y][(int)level_state.player.x];
-	if (wallCollision && !level_state.player_collided) {
-		level_state.player_collided = true;
-		clock_time_at_player_collision = clock();
+	// The player is in whichever cell their center is in.
+	int player_cell_x = (int) floorf(level_state.player.x + 0.5f);
+	int player_cell_y = (int) floorf(level_state.player.y + 0.5f);
+	bool levelFinished = level.finish.x == player_cell_x && level.finish.y == player_cell_y;
+	if (levelFinished) {
+		advance_to_level(next_level_index(level_index));
 	}
 
-	bool levelFinished = level.finish.x == (int)level_state.player.x && level.finish.y == (int)level_state.player.y;
-	if (levelFinished) {
-		level_index++;
-		if (level_index == sizeof(levels) / sizeof(levels[0])) {
-			level_index = 0;
+	snapshot_t snapshot = take_snapshot();
+	if (rewind_record(&history, &snapshot, &entities)) {
+		screen_changed = true;
+	}
+}
+
+// The walls are lit before the player first moves, while the flashlight is on
+// and after a collision. When they stop being lit they fade out rather than
+// vanish, so the player is left with a moment's memory of them.
+uint8_t wall_opacity(void) {
+	bool lit = !level_state.player_moved || level_state.player_collided || level_state.flashlight_on;
+	if (lit) {
+		walls_were_lit = true;
+		walls_fading = false;
+		return 255;
+	}
+	if (walls_were_lit) {
+		walls_were_lit = false;
+		time_at_walls_dark = timing_now();
+	}
+	float fade = 1 - seconds_since(time_at_walls_dark) / WALL_FADE_SECONDS;
+	walls_fading = fade > 0;
+	return fade > 0 ? (uint8_t) (fade * 255) : 0;
+}
+
+uint8_t collision_flash_opacity(void) {
+	if (!level_state.player_collided) {
+		return 0;
+	}
+	float fade = 1 - seconds_since(time_at_player_collision) / COLLISION_FLASH_SECONDS;
+	return fade > 0 ? (uint8_t) (fade * 128) : 0;
+}
+
+void draw_layered_frame(const level_t* level) {
+	layers[LAYER_WALLS].opacity = wall_opacity();
+	if (walls_layer_level != level_index) {
+		select_layer(LAYER_WALLS);
+		clear_layer();
+		draw_walls(level->walls);
+		walls_layer_level = level_index;
+	}
+
+	select_layer(LAYER_ACTORS);
+	clear_layer();
+	draw_finish(level->finish);
+	draw_entities(&entities);
+	draw_player(level_state.player, level_state);
+
+	select_layer(LAYER_HUD);
+	clear_layer();
+	draw_flashlight_charges(level_state, *level);
+	frame_phase_end(PHASE_DRAW);
+
+	draw_performance_hud();
+	frame_phase_end(PHASE_HUD);
+
+	set_screen_tint(red, collision_flash_opacity());
+	composite_layers(frame_buffer);
+	frame_phase_end(PHASE_COMPOSITE);
+}
+
+/**
+ * Palette mode draws everything into one 8-bit frame and skips the
+ * compositor. The wall fade and collision flash are changes to the screen
+ * palette rather than blends over every pixel.
+ */
+void draw_indexed_frame(const level_t* level) {
+	if (index_background_level != level_index) {
+		index_buffer = index_background;
+		clear_color_buffer(0xFF000000);
+		draw_grid();
+		draw_walls(level->walls);
+		index_background_level = level_index;
+		// The whole background changed, so the whole frame needs it.
+		drawn_top = 0;
+		drawn_bottom = window_height - 1;
+	}
+
+	index_buffer = index_frame;
+	if (drawn_top <= drawn_bottom) {
+		int offset = drawn_top * window_width;
+		memcpy(&index_frame[offset], &index_background[offset], window_width * (drawn_bottom - drawn_top + 1));
+	}
+	drawn_top = window_height;
+	drawn_bottom = -1;
+
+	draw_finish(level->finish);
+	draw_entities(&entities);
+	draw_player(level_state.player, level_state);
+	draw_flashlight_charges(level_state, *level);
+	frame_phase_end(PHASE_DRAW);
+
+	draw_performance_hud();
+	frame_phase_end(PHASE_HUD);
+
+	update_screen_palette(wall_opacity(), red, collision_flash_opacity());
+	frame_phase_end(PHASE_COMPOSITE);
+}
+
+// Whether the screen could change without another event arriving: something
+// is animating, or a key is held that will move the game along on the next
+// tick, even if this frame didn't have one.
+bool screen_may_change(void) {
+	return walls_fading
+		|| level_state.player_collided
+		|| entities.count > 0
+		|| hud_visible
+		|| movement_input.x != 0
+		|| movement_input.y != 0
+		|| rewind_held;
+}
+
+// Blocks until an event arrives or the timeout runs out, handling the event
+// if there is one. Input that comes in while idle is as responsive as ever,
+// since the loop picks up right where it would have anyway.
+void wait_for_event(void) {
+	SDL_Event event;
+	if (SDL_WaitEventTimeout(&event, IDLE_TIMEOUT_MS)) {
+		if (event.type == SDL_KEYDOWN) {
+			latency_input_arrived(&event);
 		}
-		level_t next_level = levels[level_index];
-		level_state = create_level_state(next_level);
+		handle_event(event);
 	}
+	// The ticks that would have run while waiting wouldn't have done
+	// anything.
+	previous_frame_time = timing_now();
+	unsimulated_seconds = 0;
+}
 
-	if (level_state.player_collided && seconds_since_clock_time(clock_time_at_player_collision) > 2) {
-		level_index = 0;
-		level_t first_level = levels[level_index];
-		level_state = create_level_state(first_level);
-	};
+// The sprite renderer queues copies and fills with SDL instead of drawing
+// pixels. The performance HUD goes through the same calls.
+void draw_sprite_frame(const level_t* level) {
+	draw_sprites(level, level_state, &entities, wall_opacity());
+	frame_phase_end(PHASE_DRAW);
+
+	sprites_active = true;
+	draw_performance_hud();
+	sprites_active = false;
+	frame_phase_end(PHASE_HUD);
+
+	tint_sprites(red, collision_flash_opacity());
+	frame_phase_end(PHASE_COMPOSITE);
 }
 
 void render(void) {
@@ -112,38 +563,129 @@ void render(void) {
 	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
 	SDL_RenderClear(renderer);
 
-	// Draw a grid on screen for debugging shape sizes.
-	draw_grid();
-
-	level_t level = levels[level_index];
-
-	draw_walls(level.walls, level_state);
-	draw_finish(level.finish);
-	draw_player(level_state.player, level_state);
-	draw_flashlight_charges(level_state, level);
+	const level_t* level = &levels[level_index];
+	if (config.renderer == RENDERER_SPRITES) {
+		draw_sprite_frame(level);
+	} else if (config.palette_mode) {
+		draw_indexed_frame(level);
+	} else {
+		draw_layered_frame(level);
+	}
 
-	// Copies our color buffer to an SDL texture and copies the SDL texture to
-	// the current SDL rendering target.
-	render_color_buffer();
-	// Clear our color buffer so we can start fresh in the next frame.
-	clear_color_buffer(0xFF000000);
+	// Copies our frame buffer to an SDL texture and copies the SDL texture to
+	// the current SDL rendering target. Sprites have already been copied.
+	if (config.renderer == RENDERER_SOFTWARE) {
+		render_color_buffer();
+	}
+	frame_phase_end(PHASE_UPLOAD);
 
 	// Update the screen with any rendering performed since the previous call.
 	SDL_RenderPresent(renderer);
+	latency_frame_presented();
+	frame_phase_end(PHASE_PRESENT);
+	screen_changed = false;
 }
 
-int main(void) {
+int main(int argc, char* argv[]) {
+	if (!parse_config(argc, argv)) {
+		return 1;
+	}
+
+	if (config.list_drivers) {
+		list_render_drivers();
+		return 0;
+	}
+
+	if (config.benchmark_raster) {
+		benchmark_raster();
+		return 0;
+	}
+
+	if (config.benchmark_blend) {
+		benchmark_blend();
+		return 0;
+	}
+
+	if (config.benchmark_entities) {
+		benchmark_entities();
+		return 0;
+	}
+
+	if (config.benchmark_palette) {
+		benchmark_palette();
+		return 0;
+	}
+
+	startup_begin();
+	// Opening the window is most of startup, so build the first level on the
+	// prefetch worker meanwhile. The worker bakes walls for the compositor's
+	// walls layer. Palette mode draws them into its index background
+	// instead, which is cheap enough to do when the level changes, and the
+	// sprite renderer doesn't bake per level at all.
+	if (using_layers() && start_prefetch_worker()) {
+		prefetch_level(level_index);
+	}
+	startup_stage_done("prefetch worker");
+
 	is_running = initialize_window();
 
 	setup();
+	hud_visible = config.show_hud;
+
+	previous_frame_time = timing_now();
+	bool first_frame_presented = false;
 
 	while (is_running) {
+		frame_begin();
 		process_input();
-		update();
+		frame_phase_end(PHASE_INPUT);
+
+		uint64_t now = timing_now();
+		unsimulated_seconds += timing_ms_between(previous_frame_time, now) / 1000.0;
+		previous_frame_time = now;
+		if (unsimulated_seconds > MAX_TICKS_PER_FRAME * TICK_SECONDS) {
+			unsimulated_seconds = MAX_TICKS_PER_FRAME * TICK_SECONDS;
+		}
+		while (unsimulated_seconds >= TICK_SECONDS) {
+			if (rewind_held) {
+				rewind_one_tick();
+			} else {
+				update();
+			}
+			unsimulated_seconds -= TICK_SECONDS;
+		}
+		frame_phase_end(PHASE_UPDATE);
+
+		// The last frame is still what's on screen, so don't draw it again.
+		// Wait for something to happen instead of spinning.
+		if (config.idle && !screen_changed && !screen_may_change()) {
+			frame_cancel();
+			wait_for_event();
+			continue;
+		}
+
 		render();
+
+		if (!first_frame_presented) {
+			first_frame_presented = true;
+			startup_stage_done("first frame");
+			if (config.startup_report) {
+				startup_report(stderr);
+			}
+		}
 	}
 
+	stop_prefetch_worker();
+	destroy_sprites();
+	destroy_spatial_hash(&entity_hash);
+	destroy_entities(&entities);
+	destroy_layers();
+	index_buffer = NULL;
+	free(index_frame);
+	free(index_background);
 	destroy_window();
 
+	latency_report(stderr);
+
 	return 0;
 }
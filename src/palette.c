@@ -0,0 +1,132 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "compositor.h"
+#include "display.h"
+#include "palette.h"
+
+// The AVX2 kernel is compiled on x86 even when the build doesn't target
+// AVX2, and only used when the CPU turns out to have it.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+// The colors things are drawn with.
+uint32_t palette[PALETTE_SIZE] = {
+	[PALETTE_CLEAR] = 0xFF000000,
+	[PALETTE_WALLS] = 0xFFCCCCCC,
+};
+int palette_count = PALETTE_FIXED_COUNT;
+// The colors that end up on screen, with this frame's effects applied.
+uint32_t screen_palette[PALETTE_SIZE];
+
+/**
+ * Finds the entry for a color, adding it if it's new. The game only draws
+ * with a handful of colors, so a short search is fine, and the last color
+ * found is remembered because runs of pixels in one color are the norm.
+ */
+uint8_t palette_index(uint32_t color) {
+	static uint32_t last_color = 0xFF000000;
+	static uint8_t last_index = PALETTE_CLEAR;
+	if (color == last_color) {
+		return last_index;
+	}
+
+	int index = PALETTE_CLEAR;
+	for (int i = 0; i < palette_count; i++) {
+		if (palette[i] == color && i != PALETTE_WALLS) {
+			index = i;
+			break;
+		}
+	}
+	if (palette[index] != color) {
+		if (palette_count == PALETTE_SIZE) {
+			fprintf(stderr, "Palette is full, drawing 0x%08X as black.\n", color);
+		} else {
+			index = palette_count++;
+			palette[index] = color;
+		}
+	}
+
+	last_color = color;
+	last_index = (uint8_t) index;
+	return last_index;
+}
+
+/**
+ * Works out this frame's screen colors. The wall fade and the collision flash
+ * are the same blends the compositor does to every pixel, but done once per
+ * palette entry instead.
+ */
+void update_screen_palette(uint8_t walls_opacity, uint32_t tint_color, uint8_t tint_opacity) {
+	memcpy(screen_palette, palette, sizeof(uint32_t) * palette_count);
+
+	screen_palette[PALETTE_WALLS] = palette[PALETTE_CLEAR];
+	blend_pixels_scalar(&screen_palette[PALETTE_WALLS], &palette[PALETTE_WALLS], 1, walls_opacity);
+
+	if (tint_opacity > 0) {
+		uint32_t tint = tint_color | 0xFF000000;
+		for (int i = 0; i < palette_count; i++) {
+			blend_pixels_scalar(&screen_palette[i], &tint, 1, tint_opacity);
+		}
+	}
+}
+
+// Unrolled so eight lookups are in flight at once.
+void expand_palette_scalar(uint32_t* destination, const uint8_t* source, int count, const uint32_t* colors) {
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		destination[i + 0] = colors[source[i + 0]];
+		destination[i + 1] = colors[source[i + 1]];
+		destination[i + 2] = colors[source[i + 2]];
+		destination[i + 3] = colors[source[i + 3]];
+		destination[i + 4] = colors[source[i + 4]];
+		destination[i + 5] = colors[source[i + 5]];
+		destination[i + 6] = colors[source[i + 6]];
+		destination[i + 7] = colors[source[i + 7]];
+	}
+	for (; i < count; i++) {
+		destination[i] = colors[source[i]];
+	}
+}
+
+#ifdef HAVE_AVX2_KERNEL
+// Widens eight indices at a time and gathers their colors in one go.
+__attribute__((target("avx2")))
+void expand_palette_avx2(uint32_t* destination, const uint8_t* source, int count, const uint32_t* colors) {
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i bytes = _mm_loadl_epi64((const __m128i*) &source[i]);
+		__m256i indices = _mm256_cvtepu8_epi32(bytes);
+		__m256i pixels = _mm256_i32gather_epi32((const int*) colors, indices, 4);
+		_mm256_storeu_si256((__m256i*) &destination[i], pixels);
+	}
+	expand_palette_scalar(&destination[i], &source[i], count - i, colors);
+}
+#endif
+
+bool cpu_has_avx2(void) {
+#ifdef HAVE_AVX2_KERNEL
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+// Which kernel expand_palette() ends up using on this machine.
+const char* expand_palette_kernel_name(void) {
+	return cpu_has_avx2() ? "AVX2 gather" : "scalar";
+}
+
+// Looks up every index in colors, with the AVX2 gather if the CPU has it and
+// the unrolled scalar loop if it doesn't.
+void expand_palette(uint32_t* destination, const uint8_t* source, int count, const uint32_t* colors) {
+#ifdef HAVE_AVX2_KERNEL
+	if (cpu_has_avx2()) {
+		expand_palette_avx2(destination, source, count, colors);
+		return;
+	}
+#endif
+	expand_palette_scalar(destination, source, count, colors);
+}
@@ -0,0 +1,28 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdint.h>
+
+#define PALETTE_SIZE 256
+
+// Entries with a fixed meaning. Every other color gets the next free entry
+// the first time something is drawn with it.
+typedef enum {
+	// Black. Index buffers are cleared to it.
+	PALETTE_CLEAR,
+	// The walls have an entry of their own so they can fade out without
+	// taking anything else drawn in the same color with them.
+	PALETTE_WALLS,
+	PALETTE_FIXED_COUNT,
+} palette_entry_t;
+
+extern uint32_t palette[PALETTE_SIZE];
+extern uint32_t screen_palette[PALETTE_SIZE];
+
+uint8_t palette_index(uint32_t color);
+void update_screen_palette(uint8_t walls_opacity, uint32_t tint_color, uint8_t tint_opacity);
+void expand_palette(uint32_t* destination, const uint8_t* source, int count, const uint32_t* colors);
+void expand_palette_scalar(uint32_t* destination, const uint8_t* source, int count, const uint32_t* colors);
+const char* expand_palette_kernel_name(void);
+
+#endif
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "display.h"
+#include "prefetch.h"
+
+/**
+ * A background thread prepares the next level while the current one is
+ * played, so finishing a level only has to swap in what's already built.
+ *
+ * There's one prepared level and at most one request in flight. The game
+ * thread fills in the request and posts level_requested; the worker prepares
+ * the level and posts level_ready. Until the game thread has waited on
+ * level_ready, the prepared level belongs to the worker and the game thread
+ * doesn't touch it.
+ */
+SDL_Thread* prefetch_worker = NULL;
+SDL_sem* level_requested = NULL;
+SDL_sem* level_ready = NULL;
+prepared_level_t prepared_level;
+int requested_level_index = -1;
+bool prefetch_in_flight = false;
+bool prefetch_stopping = false;
+
+int prefetch_worker_main(void* data) {
+	(void) data;
+	while (true) {
+		SDL_SemWait(level_requested);
+		if (prefetch_stopping) {
+			return 0;
+		}
+
+		prepared_level_t* prepared = &prepared_level;
+		const level_t* level = &levels[requested_level_index];
+		prepared->level_index = requested_level_index;
+		prepared->level_state = create_level_state(*level);
+
+		// The buffer is whatever walls layer was swapped out last time, so
+		// clear what was drawn on it first.
+		if (prepared->walls_drawn_top <= prepared->walls_drawn_bottom) {
+			int row_count = prepared->walls_drawn_bottom - prepared->walls_drawn_top + 1;
+			memset(
+				&prepared->walls[prepared->walls_drawn_top * window_width],
+				0,
+				sizeof(uint32_t) * window_width * row_count
+			);
+		}
+		prepared->walls_drawn_top = window_height;
+		prepared->walls_drawn_bottom = -1;
+		bake_walls(prepared->walls, level->walls, &prepared->walls_drawn_top, &prepared->walls_drawn_bottom);
+
+		SDL_SemPost(level_ready);
+	}
+}
+
+// Without a worker every level is built the old way, when it starts.
+bool start_prefetch_worker(void) {
+	prepared_level.walls = calloc(window_width * window_height, sizeof(uint32_t));
+	prepared_level.walls_drawn_top = window_height;
+	prepared_level.walls_drawn_bottom = -1;
+	level_requested = SDL_CreateSemaphore(0);
+	level_ready = SDL_CreateSemaphore(0);
+	if (!prepared_level.walls || !level_requested || !level_ready) {
+		fprintf(stderr, "Error creating level prefetch worker.\n");
+		stop_prefetch_worker();
+		return false;
+	}
+
+	prefetch_worker = SDL_CreateThread(prefetch_worker_main, "level prefetch", NULL);
+	if (!prefetch_worker) {
+		fprintf(stderr, "Error creating level prefetch worker: %s\n", SDL_GetError());
+		stop_prefetch_worker();
+		return false;
+	}
+	return true;
+}
+
+void stop_prefetch_worker(void) {
+	if (prefetch_worker) {
+		// Let any level in progress finish, so the worker is waiting for a
+		// request when it's told to stop.
+		if (prefetch_in_flight) {
+			SDL_SemWait(level_ready);
+		}
+		prefetch_stopping = true;
+		SDL_SemPost(level_requested);
+		SDL_WaitThread(prefetch_worker, NULL);
+		prefetch_worker = NULL;
+	}
+	if (level_requested) SDL_DestroySemaphore(level_requested);
+	if (level_ready) SDL_DestroySemaphore(level_ready);
+	level_requested = NULL;
+	level_ready = NULL;
+	free(prepared_level.walls);
+	prepared_level.walls = NULL;
+	prefetch_in_flight = false;
+}
+
+// Starts preparing a level in the background. If the worker is busy with a
+// different level, that one is no longer wanted, so wait for it to finish and
+// throw it away.
+void prefetch_level(int index) {
+	if (!prefetch_worker) {
+		return;
+	}
+	if (prefetch_in_flight) {
+		if (requested_level_index == index) {
+			return;
+		}
+		SDL_SemWait(level_ready);
+	}
+	requested_level_index = index;
+	prefetch_in_flight = true;
+	SDL_SemPost(level_requested);
+}
+
+/**
+ * Returns the prepared level if it's the one asked for, or NULL if the level
+ * wasn't prefetched and has to be built the slow way. Only waits if the
+ * worker hasn't finished yet, which for a level played for more than a few
+ * frames it always has. The caller may swap buffers with the returned level
+ * until the next prefetch_level call.
+ */
+prepared_level_t* take_prefetched_level(int index) {
+	if (!prefetch_in_flight) {
+		return NULL;
+	}
+	SDL_SemWait(level_ready);
+	prefetch_in_flight = false;
+	if (prepared_level.level_index != index) {
+		return NULL;
+	}
+	return &prepared_level;
+}
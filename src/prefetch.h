@@ -0,0 +1,23 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "level.h"
+
+// Everything about a level that can be worked out before it's played.
+typedef struct {
+	int level_index;
+	level_state_t level_state;
+	// The level's walls, drawn and ready to become the walls layer.
+	uint32_t* walls;
+	int walls_drawn_top;
+	int walls_drawn_bottom;
+} prepared_level_t;
+
+bool start_prefetch_worker(void);
+void stop_prefetch_worker(void);
+void prefetch_level(int index);
+prepared_level_t* take_prefetched_level(int index);
+
+#endif
@@ -0,0 +1,372 @@
+#include <string.h>
+#include "rewind.h"
+
+// Record layout: a header byte, the fields it says are there, then one byte
+// with the length of everything before it so records can be walked
+// backwards from the end.
+//
+// Header bits 0-1 and 2-3 say how many low bytes of the player's x and y XOR
+// follow. Positions only creep a little each tick, so their high bytes hardly
+// ever change.
+#define HEADER_VELOCITY 0x10
+#define HEADER_MISC 0x20
+// A run of ticks where nothing but the tick count changed. Followed by one
+// byte with the number of ticks instead of any fields.
+#define HEADER_IDLE 0x80
+
+// Bits of the byte after the header when HEADER_MISC is set.
+#define MISC_FLAGS 0x01
+#define MISC_CHARGES 0x02
+#define MISC_LEVEL 0x04
+// Set when the tick count didn't just go up by one, like on a level change.
+#define MISC_TICKS 0x08
+#define MISC_PICKUPS 0x10
+
+// Bytes stored for each of the 2 bit position length codes.
+const int position_code_bytes[4] = { 0, 2, 3, 4 };
+
+// The snapshot flattened into the words that get XORed.
+typedef struct {
+	uint32_t player_x;
+	uint32_t player_y;
+	uint32_t velocity_x;
+	uint32_t velocity_y;
+	uint32_t flags;
+	uint32_t charges;
+	uint32_t level_index;
+	uint32_t level_ticks;
+	uint32_t collected_pickups;
+} packed_snapshot_t;
+
+uint32_t float_bits(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+float bits_float(uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+packed_snapshot_t pack_snapshot(const snapshot_t* snapshot) {
+	const level_state_t* state = &snapshot->level_state;
+	packed_snapshot_t packed = {
+		.player_x = float_bits(state->player.x),
+		.player_y = float_bits(state->player.y),
+		.velocity_x = float_bits(state->player_velocity.x),
+		.velocity_y = float_bits(state->player_velocity.y),
+		.flags = state->player_moved | (state->flashlight_on << 1) | (state->player_collided << 2),
+		.charges = (uint32_t) state->flashlight_charges,
+		.level_index = (uint32_t) snapshot->level_index,
+		.level_ticks = snapshot->level_ticks,
+		.collected_pickups = state->collected_pickups,
+	};
+	return packed;
+}
+
+snapshot_t unpack_snapshot(const packed_snapshot_t* packed) {
+	snapshot_t snapshot;
+	level_state_t* state = &snapshot.level_state;
+	state->player.x = bits_float(packed->player_x);
+	state->player.y = bits_float(packed->player_y);
+	state->player_velocity.x = bits_float(packed->velocity_x);
+	state->player_velocity.y = bits_float(packed->velocity_y);
+	state->player_moved = packed->flags & 1;
+	state->flashlight_on = (packed->flags >> 1) & 1;
+	state->player_collided = (packed->flags >> 2) & 1;
+	state->flashlight_charges = (int) packed->charges;
+	state->collected_pickups = (uint16_t) packed->collected_pickups;
+	snapshot.level_index = (int) packed->level_index;
+	snapshot.level_ticks = packed->level_ticks;
+	return snapshot;
+}
+
+uint8_t read_byte(const rewind_buffer_t* buffer, int position) {
+	return buffer->bytes[position % REWIND_BUFFER_BYTES];
+}
+
+void write_byte(rewind_buffer_t* buffer, int position, uint8_t value) {
+	buffer->bytes[position % REWIND_BUFFER_BYTES] = value;
+}
+
+// Little endian, low bytes only.
+uint32_t read_value(const rewind_buffer_t* buffer, int* position, int byte_count) {
+	uint32_t value = 0;
+	for (int i = 0; i < byte_count; i++) {
+		value |= (uint32_t) read_byte(buffer, *position) << (i * 8);
+		(*position)++;
+	}
+	return value;
+}
+
+void write_value(rewind_buffer_t* buffer, int* position, uint32_t value, int byte_count) {
+	for (int i = 0; i < byte_count; i++) {
+		write_byte(buffer, *position, (uint8_t) (value >> (i * 8)));
+		(*position)++;
+	}
+}
+
+int position_code(uint32_t difference) {
+	if (difference == 0) return 0;
+	if (difference <= 0xFFFF) return 1;
+	if (difference <= 0xFFFFFF) return 2;
+	return 3;
+}
+
+int misc_bytes(uint8_t misc) {
+	return ((misc & MISC_FLAGS) ? 1 : 0)
+		+ ((misc & MISC_CHARGES) ? 4 : 0)
+		+ ((misc & MISC_LEVEL) ? 4 : 0)
+		+ ((misc & MISC_TICKS) ? 4 : 0)
+		+ ((misc & MISC_PICKUPS) ? 2 : 0);
+}
+
+// Size of the record starting at position, not counting its length byte.
+int record_length(const rewind_buffer_t* buffer, int position) {
+	uint8_t header = read_byte(buffer, position);
+	if (header & HEADER_IDLE) {
+		return 2;
+	}
+	int length = 1 + position_code_bytes[header & 3] + position_code_bytes[(header >> 2) & 3];
+	if (header & HEADER_VELOCITY) {
+		length += 8;
+	}
+	if (header & HEADER_MISC) {
+		length += 1 + misc_bytes(read_byte(buffer, position + length));
+	}
+	return length;
+}
+
+int record_ticks(const rewind_buffer_t* buffer, int position) {
+	uint8_t header = read_byte(buffer, position);
+	return (header & HEADER_IDLE) ? read_byte(buffer, position + 1) : 1;
+}
+
+void drop_oldest_record(rewind_buffer_t* buffer) {
+	int length = record_length(buffer, buffer->head) + 1;
+	buffer->ticks -= record_ticks(buffer, buffer->head);
+	buffer->head = (buffer->head + length) % REWIND_BUFFER_BYTES;
+	buffer->used -= length;
+}
+
+// Where the newest record starts. Only valid when there is one.
+int newest_record(const rewind_buffer_t* buffer) {
+	int end = buffer->head + buffer->used;
+	int length = read_byte(buffer, end - 1);
+	return end - 1 - length;
+}
+
+void rewind_reset(rewind_buffer_t* buffer) {
+	buffer->head = 0;
+	buffer->used = 0;
+	buffer->ticks = 0;
+	buffer->has_newest = false;
+	buffer->newest_tick = 0;
+	buffer->keyframe_head = 0;
+	buffer->keyframe_count = 0;
+}
+
+const keyframe_t* oldest_keyframe(const rewind_buffer_t* buffer) {
+	return &buffer->keyframes[buffer->keyframe_head];
+}
+
+const keyframe_t* newest_keyframe(const rewind_buffer_t* buffer) {
+	return &buffer->keyframes[(buffer->keyframe_head + buffer->keyframe_count - 1) % KEYFRAME_COUNT];
+}
+
+// Saves the entities as they are at the newest tick, dropping the oldest
+// keyframe if the ring is full.
+void save_keyframe(rewind_buffer_t* buffer, uint32_t level_ticks, const entities_t* entities) {
+	if (buffer->keyframe_count == KEYFRAME_COUNT) {
+		buffer->keyframe_head = (buffer->keyframe_head + 1) % KEYFRAME_COUNT;
+		buffer->keyframe_count--;
+	}
+	keyframe_t* keyframe = &buffer->keyframes[(buffer->keyframe_head + buffer->keyframe_count) % KEYFRAME_COUNT];
+	buffer->keyframe_count++;
+
+	int count = entities->count < MAX_LEVEL_ENTITIES ? entities->count : MAX_LEVEL_ENTITIES;
+	keyframe->tick = buffer->newest_tick;
+	keyframe->level_ticks = level_ticks;
+	keyframe->count = count;
+	memcpy(keyframe->x, entities->x, sizeof(float) * count);
+	memcpy(keyframe->y, entities->y, sizeof(float) * count);
+	memcpy(keyframe->velocity_x, entities->velocity_x, sizeof(float) * count);
+	memcpy(keyframe->velocity_y, entities->velocity_y, sizeof(float) * count);
+	memcpy(keyframe->kind, entities->kind, count);
+	memcpy(keyframe->flags, entities->flags, count);
+	memcpy(keyframe->spawn, entities->spawn, count);
+}
+
+/**
+ * Adds a tick to the history. Call it once per tick with the state at the end
+ * of that tick. Nothing is allocated: the record is built straight into the
+ * ring, dropping the oldest records first if there isn't room.
+ *
+ * Returns false if nothing but the tick count changed since the last tick.
+ */
+bool rewind_record(rewind_buffer_t* buffer, const snapshot_t* snapshot, const entities_t* entities) {
+	if (!buffer->has_newest) {
+		buffer->newest = *snapshot;
+		buffer->has_newest = true;
+		save_keyframe(buffer, snapshot->level_ticks, entities);
+		return true;
+	}
+
+	packed_snapshot_t older = pack_snapshot(&buffer->newest);
+	packed_snapshot_t newer = pack_snapshot(snapshot);
+	buffer->newest = *snapshot;
+
+	uint32_t x = older.player_x ^ newer.player_x;
+	uint32_t y = older.player_y ^ newer.player_y;
+	uint32_t velocity_x = older.velocity_x ^ newer.velocity_x;
+	uint32_t velocity_y = older.velocity_y ^ newer.velocity_y;
+	uint8_t misc = 0;
+	if (older.flags != newer.flags) misc |= MISC_FLAGS;
+	if (older.charges != newer.charges) misc |= MISC_CHARGES;
+	if (older.level_index != newer.level_index) misc |= MISC_LEVEL;
+	if (newer.level_ticks != older.level_ticks + 1) misc |= MISC_TICKS;
+	if (older.collected_pickups != newer.collected_pickups) misc |= MISC_PICKUPS;
+
+	// A new level, a restart or a collected pickup changes the entities in a
+	// way that playing them forward wouldn't.
+	buffer->newest_tick++;
+	bool entities_replaced = misc & (MISC_LEVEL | MISC_TICKS | MISC_PICKUPS);
+	bool keyframe_due = entities->count > 0 && buffer->newest_tick - newest_keyframe(buffer)->tick >= KEYFRAME_TICKS;
+	if (entities_replaced || keyframe_due) {
+		save_keyframe(buffer, snapshot->level_ticks, entities);
+	}
+
+	bool idle = x == 0 && y == 0 && velocity_x == 0 && velocity_y == 0 && misc == 0;
+	if (idle && buffer->used > 0) {
+		int newest = newest_record(buffer);
+		uint8_t run = read_byte(buffer, newest + 1);
+		if ((read_byte(buffer, newest) & HEADER_IDLE) && run < 255) {
+			write_byte(buffer, newest + 1, run + 1);
+			buffer->ticks++;
+			return false;
+		}
+	}
+
+	uint8_t header;
+	int length;
+	if (idle) {
+		header = HEADER_IDLE;
+		length = 2;
+	} else {
+		header = position_code(x) | (position_code(y) << 2);
+		if (velocity_x != 0 || velocity_y != 0) header |= HEADER_VELOCITY;
+		if (misc != 0) header |= HEADER_MISC;
+		length = 1 + position_code_bytes[header & 3] + position_code_bytes[(header >> 2) & 3]
+			+ ((header & HEADER_VELOCITY) ? 8 : 0)
+			+ ((header & HEADER_MISC) ? 1 + misc_bytes(misc) : 0);
+	}
+
+	while (buffer->used > 0 && REWIND_BUFFER_BYTES - buffer->used < length + 1) {
+		drop_oldest_record(buffer);
+	}
+
+	int position = buffer->head + buffer->used;
+	write_value(buffer, &position, header, 1);
+	if (idle) {
+		write_value(buffer, &position, 1, 1);
+	} else {
+		write_value(buffer, &position, x, position_code_bytes[header & 3]);
+		write_value(buffer, &position, y, position_code_bytes[(header >> 2) & 3]);
+		if (header & HEADER_VELOCITY) {
+			write_value(buffer, &position, velocity_x, 4);
+			write_value(buffer, &position, velocity_y, 4);
+		}
+		if (header & HEADER_MISC) {
+			write_value(buffer, &position, misc, 1);
+			if (misc & MISC_FLAGS) write_value(buffer, &position, older.flags ^ newer.flags, 1);
+			if (misc & MISC_CHARGES) write_value(buffer, &position, older.charges ^ newer.charges, 4);
+			if (misc & MISC_LEVEL) write_value(buffer, &position, older.level_index ^ newer.level_index, 4);
+			if (misc & MISC_TICKS) write_value(buffer, &position, older.level_ticks ^ newer.level_ticks, 4);
+			if (misc & MISC_PICKUPS) write_value(buffer, &position, older.collected_pickups ^ newer.collected_pickups, 2);
+		}
+	}
+	write_value(buffer, &position, (uint32_t) length, 1);
+
+	buffer->used += length + 1;
+	buffer->ticks++;
+	return !idle;
+}
+
+/**
+ * Goes back one tick. Writes the state from the tick before the newest one
+ * into snapshot, which then becomes the newest. Returns false, leaving
+ * snapshot alone, when there's no more history. That includes ticks from
+ * before the oldest keyframe, whose entities can't be brought back.
+ */
+bool rewind_step_back(rewind_buffer_t* buffer, snapshot_t* snapshot) {
+	if (buffer->ticks == 0 || oldest_keyframe(buffer)->tick >= buffer->newest_tick) {
+		return false;
+	}
+
+	int start = newest_record(buffer);
+	int position = start;
+	uint8_t header = (uint8_t) read_value(buffer, &position, 1);
+	packed_snapshot_t state = pack_snapshot(&buffer->newest);
+
+	if (header & HEADER_IDLE) {
+		uint8_t run = read_byte(buffer, position);
+		state.level_ticks--;
+		if (run > 1) {
+			write_byte(buffer, position, run - 1);
+		} else {
+			buffer->used = start - buffer->head;
+		}
+	} else {
+		state.player_x ^= read_value(buffer, &position, position_code_bytes[header & 3]);
+		state.player_y ^= read_value(buffer, &position, position_code_bytes[(header >> 2) & 3]);
+		if (header & HEADER_VELOCITY) {
+			state.velocity_x ^= read_value(buffer, &position, 4);
+			state.velocity_y ^= read_value(buffer, &position, 4);
+		}
+		uint8_t misc = 0;
+		if (header & HEADER_MISC) {
+			misc = (uint8_t) read_value(buffer, &position, 1);
+			if (misc & MISC_FLAGS) state.flags ^= read_value(buffer, &position, 1);
+			if (misc & MISC_CHARGES) state.charges ^= read_value(buffer, &position, 4);
+			if (misc & MISC_LEVEL) state.level_index ^= read_value(buffer, &position, 4);
+			if (misc & MISC_TICKS) state.level_ticks ^= read_value(buffer, &position, 4);
+			if (misc & MISC_PICKUPS) state.collected_pickups ^= read_value(buffer, &position, 2);
+		}
+		if (!(misc & MISC_TICKS)) {
+			state.level_ticks--;
+		}
+		buffer->used = start - buffer->head;
+	}
+
+	buffer->ticks--;
+	buffer->newest = unpack_snapshot(&state);
+	*snapshot = buffer->newest;
+
+	buffer->newest_tick--;
+	while (newest_keyframe(buffer)->tick > buffer->newest_tick) {
+		buffer->keyframe_count--;
+	}
+	return true;
+}
+
+/**
+ * Puts back the entities from the newest tick's keyframe. Returns the level
+ * tick the keyframe was saved at. The entities then have to be played
+ * forward to the newest tick, which is fewer than KEYFRAME_TICKS away unless
+ * there aren't any.
+ */
+uint32_t rewind_restore_entities(const rewind_buffer_t* buffer, entities_t* entities) {
+	const keyframe_t* keyframe = newest_keyframe(buffer);
+	int count = keyframe->count;
+	entities->count = count;
+	memcpy(entities->x, keyframe->x, sizeof(float) * count);
+	memcpy(entities->y, keyframe->y, sizeof(float) * count);
+	memcpy(entities->velocity_x, keyframe->velocity_x, sizeof(float) * count);
+	memcpy(entities->velocity_y, keyframe->velocity_y, sizeof(float) * count);
+	memcpy(entities->kind, keyframe->kind, count);
+	memcpy(entities->flags, keyframe->flags, count);
+	memcpy(entities->spawn, keyframe->spawn, count);
+	return keyframe->level_ticks;
+}
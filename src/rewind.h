@@ -0,0 +1,78 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "entity.h"
+#include "level.h"
+
+// Enough for several minutes of moving around, and far more standing still.
+#define REWIND_BUFFER_BYTES (64 * 1024)
+// While there are entities, their state is saved this often. Going back to
+// any tick replays fewer than this many ticks of them from the last save.
+#define KEYFRAME_TICKS 30
+// At one keyframe per KEYFRAME_TICKS, a little over four minutes.
+#define KEYFRAME_COUNT 512
+
+// Everything needed to put the game back the way it was at one tick.
+typedef struct {
+	int level_index;
+	// Ticks since the level started.
+	uint32_t level_ticks;
+	level_state_t level_state;
+} snapshot_t;
+
+/**
+ * The entities as they were at the end of one tick, in the same order. Only
+ * the level's own entities are alive during play, so there are never more
+ * than MAX_LEVEL_ENTITIES.
+ */
+typedef struct {
+	// Which recorded tick this is. Counts up from the last reset.
+	uint32_t tick;
+	uint32_t level_ticks;
+	int count;
+	float x[MAX_LEVEL_ENTITIES];
+	float y[MAX_LEVEL_ENTITIES];
+	float velocity_x[MAX_LEVEL_ENTITIES];
+	float velocity_y[MAX_LEVEL_ENTITIES];
+	uint8_t kind[MAX_LEVEL_ENTITIES];
+	uint8_t flags[MAX_LEVEL_ENTITIES];
+	uint8_t spawn[MAX_LEVEL_ENTITIES];
+} keyframe_t;
+
+/**
+ * Recent history as a ring of variable-length records. Each record holds the
+ * XOR of the fields that changed between one tick and the next, which takes
+ * the newer state back to the older one. Stepping back pops the newest record
+ * and applies it. When the ring is full the oldest records are dropped.
+ *
+ * Entities are kept in a second ring of keyframes. Between keyframes they
+ * only move and bounce off each other, which doesn't depend on the player,
+ * so any tick's entities are its keyframe's played forward. Whatever else
+ * changes them, like a pickup being collected or a new level, gets a
+ * keyframe of its own.
+ */
+typedef struct {
+	uint8_t bytes[REWIND_BUFFER_BYTES];
+	// Where the oldest record starts.
+	int head;
+	int used;
+	// How many ticks back we can go.
+	int ticks;
+	// The most recent tick recorded. Records lead back from here.
+	snapshot_t newest;
+	bool has_newest;
+	uint32_t newest_tick;
+	keyframe_t keyframes[KEYFRAME_COUNT];
+	// Where the oldest keyframe is.
+	int keyframe_head;
+	int keyframe_count;
+} rewind_buffer_t;
+
+void rewind_reset(rewind_buffer_t* buffer);
+bool rewind_record(rewind_buffer_t* buffer, const snapshot_t* snapshot, const entities_t* entities);
+bool rewind_step_back(rewind_buffer_t* buffer, snapshot_t* snapshot);
+uint32_t rewind_restore_entities(const rewind_buffer_t* buffer, entities_t* entities);
+
+#endif
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include "display.h"
+#include "hud.h"
+#include "sprites.h"
+
+/**
+ * A renderer that never uploads a frame. Everything that looks the same from
+ * frame to frame is drawn once, at startup, with the software draw functions
+ * and baked into textures. Each frame is then a list of copies from those
+ * textures and flat rectangles, which SDL batches up, so the cost goes with
+ * how many things are on screen rather than how many pixels. Only plain
+ * copies, fills and alpha or color modulation are used, all of which SDL's
+ * software renderer supports.
+ */
+bool sprites_active = false;
+
+// Every sprite is one cell in a strip of cells.
+typedef enum {
+	SPRITE_WALL,
+	SPRITE_FINISH,
+	SPRITE_PLAYER,
+	SPRITE_PLAYER_COLLIDED,
+	SPRITE_CHARGE_UNUSED,
+	SPRITE_CHARGE_USED,
+	SPRITE_FLASHLIGHT,
+	SPRITE_COUNT,
+} sprite_t;
+
+SDL_Texture* sprite_atlas = NULL;
+
+SDL_Point* grid_points = NULL;
+int grid_point_count = 0;
+
+// Where the walls go, worked out once per level.
+SDL_Rect wall_rects[LEVEL_HEIGHT * LEVEL_WIDTH];
+int wall_rect_count = 0;
+const level_t* wall_rects_level = NULL;
+
+// Fill rects are collected and sent in runs of this many.
+#define RECT_BATCH_SIZE 256
+
+/**
+ * Copies a rectangle of a screen-sized pixel buffer into a new texture that
+ * blends with what's under it. Returns NULL if SDL couldn't make one.
+ */
+SDL_Texture* bake_texture(const uint32_t* pixels, int x, int y, int width, int height) {
+	SDL_Texture* texture = SDL_CreateTexture(
+		renderer,
+		SDL_PIXELFORMAT_ARGB8888,
+		SDL_TEXTUREACCESS_STATIC,
+		width,
+		height
+	);
+	if (!texture) {
+		fprintf(stderr, "Error creating sprite texture: %s\n", SDL_GetError());
+		return NULL;
+	}
+	SDL_UpdateTexture(texture, NULL, &pixels[y * window_width + x], (int) (window_width * sizeof(uint32_t)));
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+	return texture;
+}
+
+SDL_Rect sprite_source(sprite_t sprite) {
+	SDL_Rect source = { .x = sprite * cell_size, .y = 0, .w = cell_size, .h = cell_size };
+	return source;
+}
+
+void draw_sprite(sprite_t sprite, int x, int y) {
+	SDL_Rect source = sprite_source(sprite);
+	SDL_Rect destination = { .x = x, .y = y, .w = cell_size, .h = cell_size };
+	SDL_RenderCopy(renderer, sprite_atlas, &source, &destination);
+}
+
+// Draws each sprite into its own cell of a scratch buffer with the same
+// functions the software renderer uses, then uploads the strip.
+bool bake_sprite_atlas(void) {
+	int walls[LEVEL_HEIGHT][LEVEL_WIDTH] = { 0 };
+	walls[0][SPRITE_WALL] = 1;
+	draw_walls(walls);
+
+	vec2_t finish = { .x = SPRITE_FINISH, .y = 0 };
+	draw_finish(finish);
+
+	level_state_t player_state = { .player_collided = false };
+	vec2_t player = { .x = SPRITE_PLAYER, .y = 0 };
+	draw_player(player, player_state);
+	player_state.player_collided = true;
+	player.x = SPRITE_PLAYER_COLLIDED;
+	draw_player(player, player_state);
+
+	draw_icon(SPRITE_CHARGE_UNUSED * cell_size, 0, unused_flashlight_charge, white);
+	draw_icon(SPRITE_CHARGE_USED * cell_size, 0, used_flashlight_charge, white);
+	draw_icon(SPRITE_FLASHLIGHT * cell_size, 0, flashlight_icon, white);
+
+	sprite_atlas = bake_texture(color_buffer, 0, 0, SPRITE_COUNT * cell_size, cell_size);
+	return sprite_atlas != NULL;
+}
+
+bool create_grid_points(void) {
+	int columns = (window_width + 19) / 20;
+	int rows = (window_height + 19) / 20;
+	grid_points = malloc(sizeof(SDL_Point) * columns * rows);
+	if (!grid_points) {
+		return false;
+	}
+	for (int row = 0; row < window_height; row += 20) {
+		for (int col = 0; col < window_width; col += 20) {
+			grid_points[grid_point_count].x = col;
+			grid_points[grid_point_count].y = row;
+			grid_point_count++;
+		}
+	}
+	return true;
+}
+
+bool create_sprites(void) {
+	uint32_t* scratch = calloc(window_width * window_height, sizeof(uint32_t));
+	if (!scratch) {
+		return false;
+	}
+	uint32_t* previous_color_buffer = color_buffer;
+	color_buffer = scratch;
+
+	bool baked = bake_sprite_atlas();
+	if (baked) {
+		memset(scratch, 0, sizeof(uint32_t) * window_width * window_height);
+		baked = bake_glyph_atlas();
+	}
+
+	color_buffer = previous_color_buffer;
+	free(scratch);
+
+	if (!baked || !create_grid_points()) {
+		destroy_sprites();
+		return false;
+	}
+	return true;
+}
+
+void destroy_sprites(void) {
+	if (sprite_atlas) {
+		SDL_DestroyTexture(sprite_atlas);
+		sprite_atlas = NULL;
+	}
+	destroy_glyph_atlas();
+	free(grid_points);
+	grid_points = NULL;
+	grid_point_count = 0;
+	wall_rects_level = NULL;
+}
+
+void set_draw_color(uint32_t color, uint8_t alpha) {
+	SDL_SetRenderDrawColor(renderer, (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF, alpha);
+}
+
+void fill_sprite_rect(int x, int y, int width, int height, uint32_t color) {
+	SDL_Rect rect = { .x = x, .y = y, .w = width, .h = height };
+	set_draw_color(color, 255);
+	SDL_RenderFillRect(renderer, &rect);
+}
+
+// Fills a batch of rects of one color with a single call.
+void fill_sprite_rects(const SDL_Rect* rects, int count, uint32_t color) {
+	if (count == 0) {
+		return;
+	}
+	set_draw_color(color, 255);
+	SDL_RenderFillRects(renderer, rects, count);
+}
+
+// The wall sprite is a whole cell with the padding left transparent, so each
+// wall covers its cell exactly.
+void find_wall_rects(const level_t* level) {
+	wall_rect_count = 0;
+	for (int y = 0; y < LEVEL_HEIGHT; y++) {
+		for (int x = 0; x < LEVEL_WIDTH; x++) {
+			if (level->walls[y][x] == 1) {
+				SDL_Rect* rect = &wall_rects[wall_rect_count++];
+				rect->x = x * cell_size;
+				rect->y = y * cell_size;
+				rect->w = cell_size;
+				rect->h = cell_size;
+			}
+		}
+	}
+	wall_rects_level = level;
+}
+
+// Hazards are red squares and pickups are white ones, filled in batches of
+// one color.
+void draw_entity_rects(const entities_t* entities, entity_kind_t kind, uint32_t color) {
+	SDL_Rect rects[RECT_BATCH_SIZE];
+	int count = 0;
+	set_draw_color(color, 255);
+	for (int i = 0; i < entities->count; i++) {
+		if (entities->kind[i] != kind || !entity_rect(entities, i, &rects[count])) {
+			continue;
+		}
+		count++;
+		if (count == RECT_BATCH_SIZE) {
+			SDL_RenderFillRects(renderer, rects, count);
+			count = 0;
+		}
+	}
+	if (count > 0) {
+		SDL_RenderFillRects(renderer, rects, count);
+	}
+}
+
+/**
+ * Submits everything the software renderer draws into its layers, in the
+ * same order. Walls fade with the atlas's alpha modulation and are skipped
+ * entirely once they're gone.
+ */
+void draw_sprites(const level_t* level, level_state_t level_state, const entities_t* entities, uint8_t walls_opacity) {
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+	set_draw_color(0xFF555555, 255);
+	SDL_RenderDrawPoints(renderer, grid_points, grid_point_count);
+
+	if (walls_opacity > 0) {
+		if (wall_rects_level != level) {
+			find_wall_rects(level);
+		}
+		SDL_Rect source = sprite_source(SPRITE_WALL);
+		SDL_SetTextureAlphaMod(sprite_atlas, walls_opacity);
+		for (int i = 0; i < wall_rect_count; i++) {
+			SDL_RenderCopy(renderer, sprite_atlas, &source, &wall_rects[i]);
+		}
+		SDL_SetTextureAlphaMod(sprite_atlas, 255);
+	}
+
+	draw_sprite(SPRITE_FINISH, level->finish.x * cell_size, level->finish.y * cell_size);
+	draw_entity_rects(entities, ENTITY_HAZARD, red);
+	draw_entity_rects(entities, ENTITY_PICKUP, white);
+	draw_sprite(
+		level_state.player_collided ? SPRITE_PLAYER_COLLIDED : SPRITE_PLAYER,
+		(int) lroundf(level_state.player.x * cell_size),
+		(int) lroundf(level_state.player.y * cell_size)
+	);
+
+	if (level->flashlight_charges > 0) {
+		int x = 0;
+		int y = LEVEL_HEIGHT * cell_size;
+		for (int i = 0; i < level->flashlight_charges; i++) {
+			draw_sprite(level_state.flashlight_charges > i ? SPRITE_CHARGE_UNUSED : SPRITE_CHARGE_USED, x, y);
+			x += cell_size;
+		}
+		draw_sprite(SPRITE_FLASHLIGHT, x, y);
+	}
+}
+
+// A flat color over the whole frame, like the compositor's screen tint.
+void tint_sprites(uint32_t color, uint8_t opacity) {
+	if (opacity == 0) {
+		return;
+	}
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+	set_draw_color(color, opacity);
+	SDL_RenderFillRect(renderer, NULL);
+}
@@ -0,0 +1,23 @@
+#ifndef SPRITES_H
+#define SPRITES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include "entity.h"
+#include "level.h"
+
+// Set while the sprite renderer is drawing the frame. The draw functions
+// that the HUD shares with the software path send their shapes to the
+// renderer instead of into color_buffer.
+extern bool sprites_active;
+
+bool create_sprites(void);
+void destroy_sprites(void);
+SDL_Texture* bake_texture(const uint32_t* pixels, int x, int y, int width, int height);
+void fill_sprite_rect(int x, int y, int width, int height, uint32_t color);
+void fill_sprite_rects(const SDL_Rect* rects, int count, uint32_t color);
+void draw_sprites(const level_t* level, level_state_t level_state, const entities_t* entities, uint8_t walls_opacity);
+void tint_sprites(uint32_t color, uint8_t opacity);
+
+#endif
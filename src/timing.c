@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+
+// Inputs that arrived but haven't made it onto the screen yet. Once the next
+// frame is presented each of these turns into one latency sample.
+#define MAX_PENDING_INPUTS 64
+uint64_t pending_inputs[MAX_PENDING_INPUTS];
+int pending_input_count = 0;
+
+// Latency samples are kept in a ring so a long session doesn't grow memory.
+// The report only cares about recent behavior anyway.
+#define MAX_LATENCY_SAMPLES 4096
+double latency_samples[MAX_LATENCY_SAMPLES];
+int latency_sample_count = 0;
+int latency_sample_next = 0;
+
+// Stats for the last FRAME_HISTORY finished frames, oldest overwritten first.
+frame_stats_t frame_history[FRAME_HISTORY];
+int frame_history_count = 0;
+int frame_history_next = 0;
+
+// The frame being measured right now. It goes into the history when the
+// next one begins.
+frame_stats_t current_frame;
+uint64_t current_frame_start = 0;
+uint64_t current_phase_start = 0;
+
+uint64_t timing_now(void) {
+	return SDL_GetPerformanceCounter();
+}
+
+double timing_ms_between(uint64_t start, uint64_t end) {
+	return (double) (end - start) * 1000.0 / (double) SDL_GetPerformanceFrequency();
+}
+
+void frame_begin(void) {
+	uint64_t now = timing_now();
+
+	if (current_frame_start != 0) {
+		current_frame.frame_ms = timing_ms_between(current_frame_start, now);
+		frame_history[frame_history_next] = current_frame;
+		frame_history_next = (frame_history_next + 1) % FRAME_HISTORY;
+		if (frame_history_count < FRAME_HISTORY) {
+			frame_history_count++;
+		}
+	}
+
+	memset(&current_frame, 0, sizeof(current_frame));
+	current_frame_start = now;
+	current_phase_start = now;
+}
+
+// Drops the frame in progress, for frames that didn't draw anything. The next
+// frame_begin() starts fresh instead of counting the time since this one
+// began. Inputs that arrived during it didn't change anything on screen, so
+// there's no latency to measure for them either.
+void frame_cancel(void) {
+	current_frame_start = 0;
+	pending_input_count = 0;
+}
+
+// Everything since the last phase ended (or the frame began) is charged to
+// this phase.
+void frame_phase_end(frame_phase_t phase) {
+	uint64_t now = timing_now();
+	current_frame.phase_ms[phase] += timing_ms_between(current_phase_start, now);
+	current_phase_start = now;
+}
+
+void frame_count_upload(int pixels) {
+	current_frame.pixels_uploaded += pixels;
+}
+
+/**
+ * SDL stamps events with SDL_GetTicks() when they are queued. By the time we
+ * poll one it may have been sitting in the queue for a while, and that wait is
+ * exactly the latency we want to see. So we back-date the arrival using how
+ * old the event is.
+ */
+void latency_input_arrived(const SDL_Event* event) {
+	if (pending_input_count == MAX_PENDING_INPUTS) {
+		return;
+	}
+
+	uint64_t now = timing_now();
+	uint32_t age_ms = SDL_GetTicks() - event->common.timestamp;
+	uint64_t age = (uint64_t) age_ms * SDL_GetPerformanceFrequency() / 1000;
+	if (age > now) {
+		age = now;
+	}
+
+	pending_inputs[pending_input_count] = now - age;
+	pending_input_count++;
+}
+
+void latency_frame_presented(void) {
+	if (pending_input_count == 0) {
+		return;
+	}
+
+	uint64_t now = timing_now();
+	for (int i = 0; i < pending_input_count; i++) {
+		latency_samples[latency_sample_next] = timing_ms_between(pending_inputs[i], now);
+		latency_sample_next = (latency_sample_next + 1) % MAX_LATENCY_SAMPLES;
+		if (latency_sample_count < MAX_LATENCY_SAMPLES) {
+			latency_sample_count++;
+		}
+	}
+	pending_input_count = 0;
+}
+
+int compare_doubles(const void* a, const void* b) {
+	double left = *(const double*) a;
+	double right = *(const double*) b;
+	return (left > right) - (left < right);
+}
+
+double sorted_percentile(const double* sorted, int count, double percentile) {
+	int index = (int) (percentile / 100.0 * (count - 1) + 0.5);
+	return sorted[index];
+}
+
+void latency_report(FILE* stream) {
+	if (latency_sample_count == 0) {
+		return;
+	}
+
+	double sorted[MAX_LATENCY_SAMPLES];
+	memcpy(sorted, latency_samples, sizeof(double) * latency_sample_count);
+	qsort(sorted, latency_sample_count, sizeof(double), compare_doubles);
+
+	fprintf(
+		stream,
+		"Input-to-present latency over %d inputs: p50 %.2fms, p90 %.2fms, p99 %.2fms, max %.2fms\n",
+		latency_sample_count,
+		sorted_percentile(sorted, latency_sample_count, 50),
+		sorted_percentile(sorted, latency_sample_count, 90),
+		sorted_percentile(sorted, latency_sample_count, 99),
+		sorted[latency_sample_count - 1]
+	);
+}
+
+// Startup is timed as a list of stages from startup_begin() up to the first
+// frame, each ending where the next begins.
+#define MAX_STARTUP_STAGES 16
+const char* startup_stage_names[MAX_STARTUP_STAGES];
+uint64_t startup_stage_ends[MAX_STARTUP_STAGES];
+int startup_stage_count = 0;
+uint64_t startup_start = 0;
+
+void startup_begin(void) {
+	startup_start = timing_now();
+	startup_stage_count = 0;
+}
+
+void startup_stage_done(const char* stage) {
+	if (startup_start == 0 || startup_stage_count == MAX_STARTUP_STAGES) {
+		return;
+	}
+	startup_stage_names[startup_stage_count] = stage;
+	startup_stage_ends[startup_stage_count] = timing_now();
+	startup_stage_count++;
+}
+
+void startup_report(FILE* stream) {
+	if (startup_stage_count == 0) {
+		return;
+	}
+
+	uint64_t end = startup_stage_ends[startup_stage_count - 1];
+	fprintf(stream, "Time to first frame: %.2fms\n", timing_ms_between(startup_start, end));
+	uint64_t stage_start = startup_start;
+	for (int i = 0; i < startup_stage_count; i++) {
+		fprintf(stream, "  %-20s %8.2fms\n", startup_stage_names[i], timing_ms_between(stage_start, startup_stage_ends[i]));
+		stage_start = startup_stage_ends[i];
+	}
+}
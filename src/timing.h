@@ -0,0 +1,48 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+typedef enum {
+	PHASE_INPUT,
+	PHASE_UPDATE,
+	PHASE_DRAW,
+	PHASE_HUD,
+	PHASE_COMPOSITE,
+	PHASE_UPLOAD,
+	PHASE_PRESENT,
+	PHASE_COUNT,
+} frame_phase_t;
+
+typedef struct {
+	double frame_ms;
+	double phase_ms[PHASE_COUNT];
+	int pixels_uploaded;
+} frame_stats_t;
+
+// How many finished frames we keep stats for.
+#define FRAME_HISTORY 120
+
+extern frame_stats_t frame_history[FRAME_HISTORY];
+extern int frame_history_count;
+extern int frame_history_next;
+
+uint64_t timing_now(void);
+double timing_ms_between(uint64_t start, uint64_t end);
+
+void frame_begin(void);
+void frame_cancel(void);
+void frame_phase_end(frame_phase_t phase);
+void frame_count_upload(int pixels);
+
+void latency_input_arrived(const SDL_Event* event);
+void latency_frame_presented(void);
+void latency_report(FILE* stream);
+
+void startup_begin(void);
+void startup_stage_done(const char* stage);
+void startup_report(FILE* stream);
+
+#endif